@@ -0,0 +1,92 @@
+#!/bin/bash
+# Times element-wise array statements, z[i] = a[i] + b[i] * c, over int and
+# float arrays of a million elements. The program declares the arrays and
+# runs one statement per element index for the first -s indices (a while
+# body runs once, so each index is a statement of its own). The time of the
+# same program without the statements is subtracted, leaving the cost of the
+# element accesses. Prints elements per second for each type. With -r REV it
+# also builds parser.cpp as of git revision REV and times that the same way.
+#
+# usage: bench/arrays.sh [-n elements] [-s statements] [-r rev] [-o outdir]
+
+set -e
+cd "$(dirname "$0")/.."
+
+ELEMENTS=1000000
+STATEMENTS=20000
+REV=
+OUT=bench/out
+
+while getopts "n:s:r:o:" opt; do
+    case $opt in
+        n) ELEMENTS=$OPTARG ;;
+        s) STATEMENTS=$OPTARG ;;
+        r) REV=$OPTARG ;;
+        o) OUT=$OPTARG ;;
+        *) echo "usage: $0 [-n elements] [-s statements] [-r rev] [-o outdir]" >&2; exit 1 ;;
+    esac
+done
+
+mkdir -p "$OUT/arrays"
+gcc -O2 -c lex.yy.c -o "$OUT/lex.yy.o"
+g++ -std=gnu++17 -O2 parser.cpp "$OUT/lex.yy.o" -o "$OUT/parser" -lpthread
+parsers=("$OUT/parser")
+if [ -n "$REV" ]; then
+    rm -rf "$OUT/arrays/rev"
+    mkdir -p "$OUT/arrays/rev"
+    git archive "$REV" | tar -x -C "$OUT/arrays/rev"
+    gcc -O2 -c "$OUT/arrays/rev/lex.yy.c" -o "$OUT/arrays/rev/lex.yy.o"
+    g++ -std=gnu++17 -O2 "$OUT/arrays/rev/parser.cpp" "$OUT/arrays/rev/lex.yy.o" -o "$OUT/arrays/parser_rev" -lpthread
+    parsers+=("$OUT/arrays/parser_rev")
+fi
+
+# program TYPE CONSTANT WITH-STATEMENTS
+program() {
+    echo "Program arrays {"
+    echo "    $1 a[$ELEMENTS];"
+    echo "    $1 b[$ELEMENTS];"
+    echo "    $1 z[$ELEMENTS];"
+    echo "    $1 c;"
+    echo "    c = $2"
+    if [ "$3" = 1 ]; then
+        awk -v n="$STATEMENTS" -v size="$ELEMENTS" \
+            'BEGIN { for (i = 0; i < n; i++) { k = i % size; printf "    z[%d] = a[%d] + b[%d] * c\n", k, k, k } }'
+    fi
+    echo "}."
+}
+
+for type in int float; do
+    constant=3
+    [ $type = float ] && constant=1.5
+    program $type $constant 1 > "$OUT/arrays/$type.txt"
+    program $type $constant 0 > "$OUT/arrays/${type}_empty.txt"
+done
+
+timed() {
+    local start end
+    start=$(date +%s%N)
+    if ! "$1" < "$2" > /dev/null; then
+        echo "$1 failed on $2" >&2
+        exit 1
+    fi
+    end=$(date +%s%N)
+    echo $(( (end - start) / 1000 ))
+}
+
+for parser in "${parsers[@]}"; do
+    for type in int float; do
+        # the fastest of three, for each program
+        best=0
+        bestEmpty=0
+        for run in 1 2 3; do
+            us=$(timed "$parser" "$OUT/arrays/$type.txt")
+            empty=$(timed "$parser" "$OUT/arrays/${type}_empty.txt")
+            (( best == 0 || us < best )) && best=$us
+            (( bestEmpty == 0 || empty < bestEmpty )) && bestEmpty=$empty
+        done
+        awk -v p="$parser" -v t=$type -v n="$STATEMENTS" -v us="$best" -v empty="$bestEmpty" -v size="$ELEMENTS" \
+            'BEGIN { d = us - empty; if (d < 1) d = 1
+                     printf "%-28s %-5s %d of %d elements: %12.0f elements/s (%d us, %d us without them)\n",
+                            p, t, n, size, n / (d / 1e6), us, empty }'
+    done
+done
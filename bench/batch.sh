@@ -0,0 +1,70 @@
+#!/bin/bash
+# Checks and times --batch. A mix of programs (the samples, generated ones of
+# several sizes, and random input from bench/lexfuzz.cpp) is run once with
+# --batch and once with a separate run per program; the output of each
+# program and its error must be the same both ways. Then the batch runs
+# again on the generated programs only, with --stats for the time each stage
+# spent working, starved and blocked, next to the separate runs.
+#
+# usage: bench/batch.sh [-p programs] [-t exec-threads] [-o outdir]
+
+set -e
+cd "$(dirname "$0")/.."
+
+PROGRAMS=100
+THREADS=
+OUT=bench/out
+
+while getopts "p:t:o:" opt; do
+    case $opt in
+        p) PROGRAMS=$OPTARG ;;
+        t) THREADS=--exec-threads=$OPTARG ;;
+        o) OUT=$OPTARG ;;
+        *) echo "usage: $0 [-p programs] [-t exec-threads] [-o outdir]" >&2; exit 1 ;;
+    esac
+done
+
+mkdir -p "$OUT/batch"
+gcc -O2 -c lex.yy.c -o "$OUT/lex.yy.o"
+g++ -std=gnu++17 -O2 parser.cpp "$OUT/lex.yy.o" -o "$OUT/parser" -lpthread
+g++ -O2 bench/gen.cpp -o "$OUT/gen"
+g++ -O2 bench/lexfuzz.cpp -o "$OUT/lexfuzz"
+
+rm -f "$OUT"/batch/*.txt
+for ((i = 1; i <= PROGRAMS; i++)); do
+    # mostly small programs, every tenth a large one
+    statements=$(( i % 10 == 0 ? 20000 : 50 + (i * 37) % 500 ))
+    "$OUT/gen" --statements $statements --depth 3 --branches 0.3 --seed $i > "$OUT/batch/gen$i.txt"
+done
+ls "$OUT"/batch/gen*.txt > "$OUT/batch_gen.list"
+for seed in 1 2 3 4 5 6 7 8; do
+    "$OUT/lexfuzz" $seed 200 > "$OUT/batch/fuzz$seed.txt"
+done
+{ ls test*.txt; cat "$OUT/batch_gen.list"; ls "$OUT"/batch/fuzz*.txt; } > "$OUT/batch_all.list"
+
+"$OUT/parser" --batch < "$OUT/batch_all.list" > "$OUT/batch.out" 2> "$OUT/batch.err" || true
+: > "$OUT/batch_single.out"
+: > "$OUT/batch_single.err"
+while read -r f; do
+    echo "=== $f ===" >> "$OUT/batch_single.out"
+    "$OUT/parser" < "$f" >> "$OUT/batch_single.out" 2> "$OUT/batch_one.err" || true
+    sed "s|^|$f: |" "$OUT/batch_one.err" >> "$OUT/batch_single.err"
+done < "$OUT/batch_all.list"
+if ! cmp -s "$OUT/batch.out" "$OUT/batch_single.out" || ! cmp -s "$OUT/batch.err" "$OUT/batch_single.err"; then
+    echo "--batch differs from separate runs" >&2
+    diff "$OUT/batch.out" "$OUT/batch_single.out" | head -10 >&2
+    diff "$OUT/batch.err" "$OUT/batch_single.err" | head -10 >&2
+    exit 1
+fi
+echo "--batch matches separate runs: $(wc -l < "$OUT/batch_all.list") programs"
+
+start=$(date +%s%N)
+"$OUT/parser" --batch --stats $THREADS < "$OUT/batch_gen.list" > /dev/null
+end=$(date +%s%N)
+echo "--batch: $(( (end - start) / 1000 )) us"
+start=$(date +%s%N)
+while read -r f; do
+    "$OUT/parser" < "$f" > /dev/null
+done < "$OUT/batch_gen.list"
+end=$(date +%s%N)
+echo "separate runs: $(( (end - start) / 1000 )) us"
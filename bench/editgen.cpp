@@ -0,0 +1,125 @@
+// Edit scripts for --incremental: reads a program, applies random edits to
+// it and writes them as session commands on stdout, with a "verify" every
+// few edits, optionally "run" and "stats" every few edits, and "tokens" and
+// "run" at the end. The edited source is written to the file given as the
+// third argument, to compare against a fresh run. Most edits keep the
+// program valid (a digit changed, a blank or comment added); the rest insert
+// or delete text at random and are usually undone a few edits later, so both
+// broken and repaired states are exercised. Some of those insert a statement
+// that stops the run, an index out of bounds or a division by zero, followed
+// by blank lines, so that the error is reported past the statement's own
+// line. With only-digits set, edits only change digits in literals or add
+// blanks.
+#include <bits/stdc++.h>
+
+using namespace std;
+
+struct Edit {
+    size_t offset;
+    size_t length;
+    string text;
+};
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        fprintf(stderr, "usage: %s program.txt seed final.txt [edits] [verify-every] [run-every] [only-digits]\n",
+                argv[0]);
+        return 1;
+    }
+    ifstream in(argv[1], ios::binary);
+    string source((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    mt19937 rng(atoi(argv[2]));
+    int edits = argc > 4 ? atoi(argv[4]) : 500;
+    int verifyEvery = argc > 5 ? atoi(argv[5]) : 1;
+    int runEvery = argc > 6 ? atoi(argv[6]) : 0;
+    bool onlyDigits = argc > 7 && atoi(argv[7]);
+
+    static const vector<string> fragments = {
+        " ", "\n", "\r\n", "/* note */", "/*", "*/", "x", "y1", "7", "3.5", "1e2", "+", "-", "*", "/",
+        "(", ")", "{", "}", "[", "]", "=", "<=", "!=", "if", "else", "while", "int", "float", ";",
+        ".", "#", "@", "!", "i0 = 1\n", "if (1 < 2) i0 = 3 else i1 = 4\n",
+    };
+    auto pick = [&](size_t n) { return uniform_int_distribution<size_t>(0, n - 1)(rng); };
+
+    // a statement that fails at run time, with where it goes: the start of a
+    // line that assigns to a variable, which the statement uses. "" if no
+    // such line was found.
+    auto failing = [&](size_t& at) -> string {
+        static const set<string> keywords = {"Program", "if", "else", "while", "int", "float"};
+        for (int tries = 0; tries < 20; ++tries) {
+            at = source.find('\n', pick(source.size() + 1));
+            if (at == string::npos)
+                return "";
+            at = source.find_first_not_of(" \t", at + 1);
+            if (at == string::npos || !isalpha((unsigned char)source[at]))
+                continue;
+            size_t end = at;
+            while (end < source.size() && (isalnum((unsigned char)source[end]) || source[end] == '_'))
+                ++end;
+            string name = source.substr(at, end - at);
+            if (keywords.count(name))
+                continue;
+            if (end < source.size() && source[end] == '[')
+                return name + "[0] = " + name + "[1000000]\n\n\n";
+            return name + " = " + name + " / (" + name + " - " + name + ")\n\n\n";
+        }
+        return "";
+    };
+
+    vector<Edit> undo;  // inverses of the random edits not yet undone
+    auto apply = [&](const Edit& e) {
+        printf("edit %zu %zu %zu\n", e.offset, e.length, e.text.size());
+        fwrite(e.text.data(), 1, e.text.size(), stdout);
+        Edit inverse{e.offset, e.text.size(), source.substr(e.offset, e.length)};
+        source.replace(e.offset, e.length, e.text);
+        return inverse;
+    };
+
+    for (int i = 0; i < edits; ++i) {
+        int kind = onlyDigits ? 3 : (int)pick(10);
+        if (!undo.empty() && (kind < 3 || undo.size() > 3)) {
+            apply(undo.back());
+            undo.pop_back();
+        } else if (kind < 6) {
+            // a digit for another, or a blank or comment between tokens
+            size_t at = pick(source.size() + 1);
+            size_t digit = source.find_first_of("0123456789", at);
+            // only-digits keeps the program valid: literals only, and no
+            // array sizes or indices
+            while (onlyDigits && digit != string::npos) {
+                size_t start = digit;
+                while (start > 0 && (isalnum((unsigned char)source[start - 1]) || strchr("_.", source[start - 1])))
+                    --start;
+                if (isdigit((unsigned char)source[start]) && (start == 0 || source[start - 1] != '['))
+                    break;
+                digit = source.find_first_of("0123456789", digit + 1);
+            }
+            if (kind < 5 && digit != string::npos)
+                apply({digit, 1, string(1, (char)('0' + pick(10)))});
+            else if (at == 0 || isspace((unsigned char)source[at - 1]))
+                apply({at, 0, kind % 2 ? " " : "/* c */ "});
+            else
+                apply({at, 0, ""});
+        } else {
+            size_t at = pick(source.size() + 1);
+            Edit e{at, 0, ""};
+            size_t line;
+            if (kind == 9 && !(e.text = failing(line)).empty())
+                e.offset = line;
+            else if (kind < 8)
+                e.text = fragments[pick(fragments.size())];
+            else
+                e.length = min(source.size() - at, 1 + pick(6));
+            undo.push_back(apply(e));
+        }
+        if (verifyEvery > 0 && (i + 1) % verifyEvery == 0)
+            printf("verify\n");
+        if (runEvery > 0 && (i + 1) % runEvery == 0)
+            printf("run\nstats\n");
+    }
+    printf("verify\ntokens\nrun\n");
+
+    ofstream out(argv[3], ios::binary);
+    out << source;
+    return 0;
+}
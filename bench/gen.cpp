@@ -0,0 +1,122 @@
+// Program generator for the benchmark suite: writes a valid program in the
+// parser's language to stdout, shaped by the options below. The same options
+// and seed always produce the same program.
+#include <bits/stdc++.h>
+
+using namespace std;
+
+struct Options {
+    int decls = 8;          // scalar variables, split between int and float
+    int arrays = 2;         // int arrays
+    int arraySize = 100;    // elements per array
+    int statements = 1000;  // top-level statements
+    int depth = 3;          // nesting depth of generated expressions
+    double branches = 0.1;  // fraction of statements that are if/else
+    unsigned seed = 1;
+};
+
+Options opt;
+mt19937 rng;
+
+int pick(int n) {
+    return uniform_int_distribution<int>(0, n - 1)(rng);
+}
+
+string intVar() {
+    return "i" + to_string(pick((opt.decls + 1) / 2));
+}
+
+string floatVar() {
+    return "f" + to_string(pick(opt.decls / 2));
+}
+
+string arrayElem() {
+    return "a" + to_string(pick(opt.arrays)) + "[" + to_string(pick(opt.arraySize)) + "]";
+}
+
+// operands never mix int and float; divisors are non-zero literals
+string intExpr(int depth) {
+    if (depth == 0) {
+        switch (pick(3)) {
+            case 0:  return to_string(pick(100));
+            case 1:  return intVar();
+            default: return opt.arrays ? arrayElem() : intVar();
+        }
+    }
+    switch (pick(4)) {
+        case 0:  return intExpr(depth - 1) + " + " + intExpr(depth - 1);
+        case 1:  return intExpr(depth - 1) + " - " + intExpr(depth - 1);
+        case 2:  return "(" + intExpr(depth - 1) + ") * " + intExpr(0);
+        default: return "(" + intExpr(depth - 1) + ") / " + to_string(1 + pick(9));
+    }
+}
+
+string floatExpr(int depth) {
+    if (depth == 0)
+        return pick(2) ? floatVar() : to_string(pick(9)) + "." + to_string(1 + pick(99));
+    switch (pick(3)) {
+        case 0:  return floatExpr(depth - 1) + " + " + floatExpr(depth - 1);
+        case 1:  return floatExpr(depth - 1) + " - " + floatExpr(depth - 1);
+        default: return "(" + floatExpr(depth - 1) + ") * " + floatExpr(0);
+    }
+}
+
+string assignment() {
+    int depth = opt.depth ? 1 + pick(opt.depth) : 0;
+    if (opt.decls / 2 > 0 && pick(4) == 0)
+        return floatVar() + " = " + floatExpr(depth);
+    if (opt.arrays && pick(2))
+        return arrayElem() + " = " + intExpr(depth);
+    return intVar() + " = " + intExpr(depth);
+}
+
+void usage(const char* prog) {
+    cerr << "Usage: " << prog << " [--decls N] [--arrays N] [--array-size N] [--statements N]\n"
+         << "       [--depth N] [--branches P] [--seed N]\n";
+    exit(1);
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (i + 1 >= argc) usage(argv[0]);
+        string val = argv[++i];
+        if (arg == "--decls") opt.decls = max(1, stoi(val));
+        else if (arg == "--arrays") opt.arrays = stoi(val);
+        else if (arg == "--array-size") opt.arraySize = max(1, stoi(val));
+        else if (arg == "--statements") opt.statements = stoi(val);
+        else if (arg == "--depth") opt.depth = stoi(val);
+        else if (arg == "--branches") opt.branches = stod(val);
+        else if (arg == "--seed") opt.seed = (unsigned)stoul(val);
+        else usage(argv[0]);
+    }
+    rng.seed(opt.seed);
+
+    string out;
+    out += "Program generated {\n";
+    for (int i = 0; i < (opt.decls + 1) / 2; ++i)
+        out += "    int i" + to_string(i) + ";\n";
+    for (int i = 0; i < opt.decls / 2; ++i)
+        out += "    float f" + to_string(i) + ";\n";
+    for (int i = 0; i < opt.arrays; ++i)
+        out += "    int a" + to_string(i) + "[" + to_string(opt.arraySize) + "];\n";
+
+    // give every scalar a value before it is read
+    for (int i = 0; i < (opt.decls + 1) / 2; ++i)
+        out += "    i" + to_string(i) + " = " + to_string(1 + pick(50)) + "\n";
+    for (int i = 0; i < opt.decls / 2; ++i)
+        out += "    f" + to_string(i) + " = " + to_string(pick(9)) + "." + to_string(1 + pick(99)) + "\n";
+
+    uniform_real_distribution<double> coin(0.0, 1.0);
+    for (int s = 0; s < opt.statements; ++s) {
+        if (coin(rng) < opt.branches) {
+            out += "    if ( " + intVar() + " < " + to_string(pick(100)) + " ) " + assignment()
+                 + " else " + assignment() + "\n";
+        } else {
+            out += "    " + assignment() + "\n";
+        }
+    }
+    out += "}.\n";
+    fwrite(out.data(), 1, out.size(), stdout);
+    return 0;
+}
@@ -0,0 +1,84 @@
+#!/bin/bash
+# Checks and times --incremental. Random edit scripts from bench/editgen.cpp
+# are run against the sample programs and generated ones. The script fails if
+# a "verify" reports a mismatch, or if the final tokens and run output differ
+# from a fresh run of the edited source. A verify also runs the source both
+# ways: from scratch, and re-executing only what changed since its last run.
+# Some edits insert statements that stop the run with an error, and the
+# summary counts the scripts whose final run stops with one.
+# Then it times single edits on a program of about 100k lines, and runs after
+# single digit changes, against one full run of the interpreter.
+#
+# usage: bench/incremental.sh [-s seeds] [-e edits] [-o outdir]
+
+set -e
+cd "$(dirname "$0")/.."
+
+SEEDS=20
+EDITS=300
+OUT=bench/out
+
+while getopts "s:e:o:" opt; do
+    case $opt in
+        s) SEEDS=$OPTARG ;;
+        e) EDITS=$OPTARG ;;
+        o) OUT=$OPTARG ;;
+        *) echo "usage: $0 [-s seeds] [-e edits] [-o outdir]" >&2; exit 1 ;;
+    esac
+done
+
+mkdir -p "$OUT"
+gcc -O2 -c lex.yy.c -o "$OUT/lex.yy.o"
+g++ -std=gnu++17 -O2 parser.cpp "$OUT/lex.yy.o" -o "$OUT/parser"
+g++ -O2 bench/gen.cpp -o "$OUT/gen"
+g++ -O2 bench/editgen.cpp -o "$OUT/editgen"
+
+for seed in 1 2 3; do
+    "$OUT/gen" --statements 40 --depth 3 --branches 0.3 --seed $seed > "$OUT/inc_gen$seed.txt"
+done
+
+checked=0
+failing=0
+for f in test*.txt "$OUT"/inc_gen*.txt; do
+    for ((seed = 1; seed <= SEEDS; seed++)); do
+        "$OUT/editgen" "$f" $seed "$OUT/inc_final.txt" $EDITS > "$OUT/inc_commands.txt"
+        "$OUT/parser" --incremental="$f" < "$OUT/inc_commands.txt" > "$OUT/inc_session.out" 2> "$OUT/inc_session.err"
+        if grep -q '^mismatch$' "$OUT/inc_session.out"; then
+            echo "incremental state differs from a fresh parse: $f, seed $seed" >&2
+            exit 1
+        fi
+        # the replies to the final "tokens" and "run"
+        awk '/^=== Done ===$/ { n++; next } { reply[n] = reply[n] $0 "\n" }
+             END { printf "%s%s", reply[n - 2], reply[n - 1] }' "$OUT/inc_session.out" > "$OUT/inc_incremental.out"
+        { "$OUT/parser" --dump-tokens < "$OUT/inc_final.txt" || true
+          "$OUT/parser" < "$OUT/inc_final.txt" || true; } > "$OUT/inc_fresh.out" 2> "$OUT/inc_fresh.err"
+        if ! cmp -s "$OUT/inc_incremental.out" "$OUT/inc_fresh.out" || ! cmp -s "$OUT/inc_session.err" "$OUT/inc_fresh.err"; then
+            echo "incremental output differs from a fresh run: $f, seed $seed" >&2
+            diff "$OUT/inc_incremental.out" "$OUT/inc_fresh.out" | head -10 >&2
+            diff "$OUT/inc_session.err" "$OUT/inc_fresh.err" | head -10 >&2
+            exit 1
+        fi
+        checked=$((checked + 1))
+        grep -q '^Semantic error' "$OUT/inc_fresh.err" && failing=$((failing + 1))
+    done
+done
+echo "incremental sessions match fresh runs: $checked scripts of $EDITS edits, $failing ending in a run-time error"
+
+"$OUT/gen" --decls 100 --statements 100000 --depth 3 --seed 1 > "$OUT/inc_big.txt"
+lines=$(wc -l < "$OUT/inc_big.txt")
+"$OUT/editgen" "$OUT/inc_big.txt" 1 "$OUT/inc_final.txt" 2000 0 | grep -v '^\(verify\|tokens\|run\)$' > "$OUT/inc_commands.txt"
+"$OUT/parser" --incremental="$OUT/inc_big.txt" < "$OUT/inc_commands.txt" \
+    | awk '/tokens lexed/ { print $(NF - 1) }' | sort -n | awk -v lines=$lines '
+        { t[NR] = $1 }
+        END { printf "%d lines, %d edits: median %.1f us, p99 %.1f us per edit\n", lines, NR, t[int((NR + 1) / 2)], t[int(NR * 0.99)] }'
+# a run after each digit change; the first one runs everything
+"$OUT/editgen" "$OUT/inc_big.txt" 2 "$OUT/inc_final.txt" 200 0 1 1 | head -n -3 > "$OUT/inc_commands.txt"
+"$OUT/parser" --incremental="$OUT/inc_big.txt" < "$OUT/inc_commands.txt" 2> /dev/null \
+    | awk '/statements run/ && n++ { print $(NF - 1), $1 }' | sort -n | awk '
+        { t[NR] = $1; executed += $2 }
+        END { printf "%d runs after one edit: median %.1f us, p99 %.1f us, %.1f statements executed on average\n",
+                     NR, t[int((NR + 1) / 2)], t[int(NR * 0.99)], executed / NR }'
+start=$(date +%s%N)
+"$OUT/parser" < "$OUT/inc_big.txt" > /dev/null
+end=$(date +%s%N)
+echo "one full run: $(( (end - start) / 1000 )) us"
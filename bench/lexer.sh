@@ -0,0 +1,76 @@
+#!/bin/bash
+# Scanner checks: runs the flex scanner, the hand-written one (--lexer=hand)
+# and the parallel chunked one (--lexer=parallel, with chunks small enough
+# that most tokens sit near a boundary) over the sample programs, generated
+# programs and random input from bench/lexfuzz.cpp, and fails on the first
+# input where their token streams, error messages or exit codes differ. Then
+# reports the median tokens/s of each on a large generated program.
+#
+# usage: bench/lexer.sh [-s fuzz-seeds] [-n runs] [-o outdir]
+
+set -e
+cd "$(dirname "$0")/.."
+
+SEEDS=2000
+RUNS=7
+OUT=bench/out
+
+while getopts "s:n:o:" opt; do
+    case $opt in
+        s) SEEDS=$OPTARG ;;
+        n) RUNS=$OPTARG ;;
+        o) OUT=$OPTARG ;;
+        *) echo "usage: $0 [-s fuzz-seeds] [-n runs] [-o outdir]" >&2; exit 1 ;;
+    esac
+done
+
+mkdir -p "$OUT"
+gcc -O2 -c lex.yy.c -o "$OUT/lex.yy.o"
+g++ -std=gnu++17 -O2 parser.cpp "$OUT/lex.yy.o" -o "$OUT/parser"
+g++ -O2 bench/gen.cpp -o "$OUT/gen"
+g++ -O2 bench/lexfuzz.cpp -o "$OUT/lexfuzz"
+
+# the reference scanner against the others on one input file: stdout,
+# stderr and exit code must match
+compare() {
+    local rc
+    "$OUT/parser" --dump-tokens < "$1" > "$OUT/lex_flex.out" 2> "$OUT/lex_flex.err" && rc=0 || rc=$?
+    echo "exit $rc" >> "$OUT/lex_flex.err"
+    for args in "--lexer=hand" "--lexer=parallel --lex-threads=2 --lex-chunk=64" \
+                "--lexer=parallel --lex-threads=3 --lex-chunk=1"; do
+        "$OUT/parser" $args --dump-tokens < "$1" > "$OUT/lex_other.out" 2> "$OUT/lex_other.err" && rc=0 || rc=$?
+        echo "exit $rc" >> "$OUT/lex_other.err"
+        if ! cmp -s "$OUT/lex_flex.out" "$OUT/lex_other.out" || ! cmp -s "$OUT/lex_flex.err" "$OUT/lex_other.err"; then
+            echo "flex and $args differ on $1 ($2):" >&2
+            diff "$OUT/lex_flex.out" "$OUT/lex_other.out" | head -10 >&2
+            diff "$OUT/lex_flex.err" "$OUT/lex_other.err" | head -10 >&2
+            exit 1
+        fi
+    done
+}
+
+checked=0
+for f in test*.txt; do
+    compare "$f" "$f"
+    checked=$((checked + 1))
+done
+for seed in 1 2 3 4 5; do
+    "$OUT/gen" --statements 2000 --depth 4 --branches 0.3 --seed $seed > "$OUT/lex_gen.txt"
+    compare "$OUT/lex_gen.txt" "gen --seed $seed"
+    checked=$((checked + 1))
+done
+for ((seed = 1; seed <= SEEDS; seed++)); do
+    "$OUT/lexfuzz" $seed $((seed % 400 + 1)) > "$OUT/lex_fuzz.txt"
+    compare "$OUT/lex_fuzz.txt" "lexfuzz $seed"
+    checked=$((checked + 1))
+done
+echo "scanners agree on $checked inputs"
+
+"$OUT/gen" --decls 100 --statements 200000 --depth 6 --seed 1 > "$OUT/lex_big.txt"
+for lexer in flex hand parallel; do
+    for ((r = 0; r < RUNS; r++)); do
+        "$OUT/parser" --lexer=$lexer --count-tokens < "$OUT/lex_big.txt" | awk '{ print $(NF - 1) }'
+    done | sort -n | awk -v l=$lexer -v b=$(wc -c < "$OUT/lex_big.txt") '
+        { t[NR] = $1 }
+        END { printf "%-8s %d bytes: median %.0f tokens/s\n", l, b, t[int((NR + 1) / 2)] }'
+done
@@ -0,0 +1,44 @@
+// Random input for the scanner differential test: a soup of fragments chosen
+// to sit on the boundaries between scanner.l's rules (keyword prefixes,
+// exponents, comments, bare carriage returns), with now and then one that the
+// scanner rejects (identifiers that run into '#' or '@', numbers with half an
+// exponent, "!" without "=", an unclosed comment). The same seed always
+// produces the same text; it is usually not a valid program.
+#include <bits/stdc++.h>
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    unsigned seed = argc > 1 ? atoi(argv[1]) : 1;
+    int fragments = argc > 2 ? atoi(argv[2]) : 200;
+    mt19937 rng(seed);
+
+    // fragments the scanner accepts, some only just
+    static const vector<string> pieces = {
+        "Program", "int", "float", "if", "else", "while", "void", "return",
+        "returns", "iff", "x", "abc12", "a_1", "b$9", "0", "7", "12", "3.5",
+        "3.", ".5", "1e5", "2e-3", "12e+7x", "+", "-", "*", "/", "<", "<=",
+        ">", ">=", "=", "==", "!=", "(", ")", "{", "}", "[", "]", ";", ",",
+        ".", "*/", "/* c */", "/*\n*/", "/*\r*/", "\r\n", "\r", "\n", " ",
+        "\t", "  ",
+    };
+    // fragments that end the scan with a lexical error
+    static const vector<string> errors = {
+        "a@", "c_", "d#", "e#1", "f1#2", "g@3#4", "h_#", "#", "@", "$", "_",
+        "1e", "1E+", "4.0e", "5.5E-", "1ea", "9e;", "!", "~", "?", "\"", "'",
+        "\x80", ":", "/*",
+    };
+    uniform_int_distribution<size_t> pick(0, pieces.size() - 1);
+    uniform_int_distribution<size_t> pickError(0, errors.size() - 1);
+    uniform_int_distribution<int> space(0, 3);
+    uniform_int_distribution<int> fail(0, fragments * 2);   // about every other input has an error
+
+    string out;
+    for (int i = 0; i < fragments; ++i) {
+        out += fail(rng) == 0 ? errors[pickError(rng)] : pieces[pick(rng)];
+        if (space(rng) == 0)
+            out += ' ';
+    }
+    fwrite(out.data(), 1, out.size(), stdout);
+    return 0;
+}
@@ -0,0 +1,84 @@
+// Overhead of step and time limits. Runs one compiled program with no
+// limits, with a step budget, with a timeout and with both (none of them
+// reached), interleaved, and prints the median time of each against the
+// unlimited runs. Then checks that a budget one step short and a tiny
+// timeout stop the run with an ErrorKind::limit error.
+//
+// usage: limits program.txt [runs]
+#include <bits/stdc++.h>
+#include "../interpreter.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s program.txt [runs]\n", argv[0]);
+        return 1;
+    }
+    ifstream in(argv[1], ios::binary);
+    string source((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    cinterp::Program program = cinterp::compile(source);
+    int runs = argc > 2 ? atoi(argv[2]) : 15;
+
+    // the run's exact step count: the smallest budget it fits in
+    uint64_t steps = 1;
+    for (;;) {
+        try {
+            cinterp::run(program, {}, {steps, 0});
+            break;
+        } catch (const cinterp::Error& e) {
+            if (e.kind != cinterp::ErrorKind::limit)
+                throw;
+            steps *= 2;
+        }
+    }
+    uint64_t low = steps / 2, high = steps;
+    while (high - low > 1) {
+        uint64_t mid = (low + high) / 2;
+        try {
+            cinterp::run(program, {}, {mid, 0});
+            high = mid;
+        } catch (const cinterp::Error&) {
+            low = mid;
+        }
+    }
+    steps = high;
+
+    const char* names[] = {"no limits", "max steps", "timeout", "both"};
+    cinterp::Limits configs[] = {{0, 0}, {steps, 0}, {0, 3600000}, {steps, 3600000}};
+    vector<double> times[4];
+    for (int r = 0; r < runs; ++r) {
+        for (int c = 0; c < 4; ++c) {
+            auto start = chrono::steady_clock::now();
+            cinterp::run(program, {}, configs[c]);
+            times[c].push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+        }
+    }
+    printf("%llu steps per run, median of %d runs\n", (unsigned long long)steps, runs);
+    double base = 0;
+    for (int c = 0; c < 4; ++c) {
+        sort(times[c].begin(), times[c].end());
+        double median = times[c][times[c].size() / 2];
+        if (c == 0)
+            base = median;
+        printf("%-10s %8.2f ms  %+5.1f%%\n", names[c], median, (median / base - 1) * 100);
+    }
+
+    for (cinterp::Limits limits : {cinterp::Limits{steps - 1, 0}, cinterp::Limits{0, 1}}) {
+        try {
+            cinterp::run(program, {}, limits);
+            if (limits.maxSteps) {
+                fprintf(stderr, "a budget of %llu steps did not stop the run\n", (unsigned long long)limits.maxSteps);
+                return 1;
+            }
+            printf("the run finished within 1 ms\n");
+        } catch (const cinterp::Error& e) {
+            if (e.kind != cinterp::ErrorKind::limit) {
+                fprintf(stderr, "unexpected error: %s\n", e.what());
+                return 1;
+            }
+            printf("%s\n", e.what());
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,29 @@
+#!/bin/bash
+# Builds the interpreter as a library and runs bench/limits.cpp on a
+# generated program: the cost of --max-steps and --timeout-ms style limits
+# that are never reached, and a check that they stop a run.
+#
+# usage: bench/limits.sh [-n runs] [-o outdir]
+
+set -e
+cd "$(dirname "$0")/.."
+
+RUNS=15
+OUT=bench/out
+
+while getopts "n:o:" opt; do
+    case $opt in
+        n) RUNS=$OPTARG ;;
+        o) OUT=$OPTARG ;;
+        *) echo "usage: $0 [-n runs] [-o outdir]" >&2; exit 1 ;;
+    esac
+done
+
+mkdir -p "$OUT"
+gcc -O2 -c lex.yy.c -o "$OUT/lex.yy.o"
+g++ -std=gnu++17 -O2 -DCINTERP_NO_MAIN -c parser.cpp -o "$OUT/interpreter.o"
+g++ -std=gnu++17 -O2 bench/limits.cpp "$OUT/interpreter.o" "$OUT/lex.yy.o" -o "$OUT/limits" -lpthread
+g++ -O2 bench/gen.cpp -o "$OUT/gen"
+
+"$OUT/gen" --statements 100000 --depth 3 --branches 0.3 --seed 1 > "$OUT/limits_program.txt"
+"$OUT/limits" "$OUT/limits_program.txt" $RUNS
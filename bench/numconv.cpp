@@ -0,0 +1,86 @@
+// Micro-benchmark for number conversions: the stoi/stof/to_string calls the
+// interpreter used to make against the from_chars/to_chars paths it uses now,
+// over the kind of text values the interpreter holds. Prints ns per
+// conversion, and checks that shortest float output reads back exactly.
+#include <bits/stdc++.h>
+
+using namespace std;
+
+volatile long long sink; // keeps results alive
+
+template <typename F>
+double nsPerOp(size_t n, F body) {
+    double best = 1e300;
+    for (int rep = 0; rep < 5; ++rep) {
+        auto start = chrono::steady_clock::now();
+        body();
+        auto end = chrono::steady_clock::now();
+        best = min(best, chrono::duration<double, nano>(end - start).count() / n);
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    size_t n = argc > 1 ? atol(argv[1]) : 1000000;
+    mt19937 rng(1);
+    uniform_int_distribution<int> ints(-100000, 100000);
+    uniform_real_distribution<float> floats(-1000, 1000);
+
+    vector<string> intText(n), floatText(n);
+    vector<int> intValues(n);
+    vector<float> floatValues(n);
+    for (size_t i = 0; i < n; ++i) {
+        intValues[i] = ints(rng);
+        floatValues[i] = floats(rng);
+        intText[i] = to_string(intValues[i]);
+        char buf[32];
+        floatText[i] = string(buf, to_chars(buf, buf + sizeof(buf), floatValues[i]).ptr);
+    }
+
+    printf("%-14s %12s %12s\n", "conversion", "old ns/op", "new ns/op");
+    auto row = [](const char* name, double before, double after) {
+        printf("%-14s %12.1f %12.1f\n", name, before, after);
+    };
+
+    row("parse int",
+        nsPerOp(n, [&] { long long s = 0; for (auto& t : intText) s += stoi(t); sink = s; }),
+        nsPerOp(n, [&] {
+            long long s = 0;
+            for (auto& t : intText) { int x = 0; from_chars(t.data(), t.data() + t.size(), x); s += x; }
+            sink = s;
+        }));
+    row("parse float",
+        nsPerOp(n, [&] { double s = 0; for (auto& t : floatText) s += stof(t); sink = (long long)s; }),
+        nsPerOp(n, [&] {
+            double s = 0;
+            for (auto& t : floatText) { float x = 0; from_chars(t.data(), t.data() + t.size(), x); s += x; }
+            sink = (long long)s;
+        }));
+    row("format int",
+        nsPerOp(n, [&] { size_t s = 0; for (int v : intValues) s += to_string(v).size(); sink = s; }),
+        nsPerOp(n, [&] {
+            size_t s = 0;
+            for (int v : intValues) { char buf[16]; s += string(buf, to_chars(buf, buf + 16, v).ptr).size(); }
+            sink = s;
+        }));
+    row("format float",
+        nsPerOp(n, [&] { size_t s = 0; for (float v : floatValues) s += to_string(v).size(); sink = s; }),
+        nsPerOp(n, [&] {
+            size_t s = 0;
+            for (float v : floatValues) { char buf[32]; s += string(buf, to_chars(buf, buf + 32, v).ptr).size(); }
+            sink = s;
+        }));
+
+    // to_string keeps 6 decimals, to_chars the shortest exact text
+    size_t lostOld = 0, lostNew = 0;
+    for (float v : floatValues) {
+        lostOld += stof(to_string(v)) != v;
+        char buf[32];
+        char* end = to_chars(buf, buf + sizeof(buf), v).ptr;
+        float back;
+        from_chars(buf, end, back);
+        lostNew += back != v;
+    }
+    printf("floats changed by a text round trip: old %zu, new %zu (of %zu)\n", lostOld, lostNew, n);
+    return 0;
+}
@@ -0,0 +1,58 @@
+#!/bin/bash
+# Checks and times --repl. The body of each sample program and of generated
+# ones is entered line by line, and the table printed by ":vars" must match
+# the final table of a normal run. Then it prints the time per entry for a
+# 10,000-statement program next to one full run of the same program.
+#
+# usage: bench/repl.sh [-o outdir]
+
+set -e
+cd "$(dirname "$0")/.."
+
+OUT=bench/out
+
+while getopts "o:" opt; do
+    case $opt in
+        o) OUT=$OPTARG ;;
+        *) echo "usage: $0 [-o outdir]" >&2; exit 1 ;;
+    esac
+done
+
+mkdir -p "$OUT"
+gcc -O2 -c lex.yy.c -o "$OUT/lex.yy.o"
+g++ -std=gnu++17 -O2 parser.cpp "$OUT/lex.yy.o" -o "$OUT/parser"
+g++ -O2 bench/gen.cpp -o "$OUT/gen"
+
+for seed in 1 2 3; do
+    "$OUT/gen" --statements 200 --depth 3 --branches 0.3 --seed $seed > "$OUT/repl_gen$seed.txt"
+done
+"$OUT/gen" --statements 10000 --depth 3 --seed 1 > "$OUT/repl_big.txt"
+
+# the program without "Program NAME {" and "}.", then the table
+entries() {
+    sed -e '1s/^[[:space:]]*Program[[:space:]]*[A-Za-z0-9]*[[:space:]]*{//' -e '$s/}[[:space:]]*\.[[:space:]]*$//' "$1"
+    echo ":vars"
+    echo ":stats"
+}
+
+checked=0
+for f in test*.txt "$OUT"/repl_gen*.txt; do
+    # only programs that run to the end have a table to compare
+    if ! "$OUT/parser" --format=sorted < "$f" > "$OUT/repl_fresh.out" 2> /dev/null; then
+        continue
+    fi
+    entries "$f" | "$OUT/parser" --format=sorted --repl 2> "$OUT/repl_session.err" | grep -v ' entries, ' > "$OUT/repl_session.out"
+    if [ -s "$OUT/repl_session.err" ] || ! grep -v '^\(=== Running\|Parsing completed\)' "$OUT/repl_fresh.out" | cmp -s - "$OUT/repl_session.out"; then
+        echo "REPL session differs from a normal run: $f" >&2
+        head -5 "$OUT/repl_session.err" >&2
+        exit 1
+    fi
+    checked=$((checked + 1))
+done
+echo "REPL sessions match normal runs: $checked programs"
+
+entries "$OUT/repl_big.txt" | "$OUT/parser" --repl | grep ' entries, '
+start=$(date +%s%N)
+"$OUT/parser" < "$OUT/repl_big.txt" > /dev/null
+end=$(date +%s%N)
+echo "one full run: $(( (end - start) / 1000 )) us"
@@ -0,0 +1,111 @@
+#!/bin/bash
+# Benchmark suite: generates programs with bench/gen.cpp, runs the parser over
+# them in each mode and reports the median wall time with a 95% confidence
+# interval, as CSV and JSON. With a baseline CSV from an earlier run, any
+# case whose interval lies entirely above the baseline's is reported as a
+# regression and the script exits non-zero. A run that fails stops the
+# script, so an early error is never timed as a fast success.
+#
+# usage: bench/run.sh [-n runs] [-o outdir] [-b baseline.csv] [-m "modes"] [-c "cases"]
+
+set -e -o pipefail
+cd "$(dirname "$0")/.."
+
+RUNS=10
+OUT=bench/out
+BASELINE=
+MODES="default stats profile perf"
+CASES="decls_1k arrays_1m statements_100k depth_8 branches_50"
+
+while getopts "n:o:b:m:c:" opt; do
+    case $opt in
+        n) RUNS=$OPTARG ;;
+        o) OUT=$OPTARG ;;
+        b) BASELINE=$OPTARG ;;
+        m) MODES=$OPTARG ;;
+        c) CASES=$OPTARG ;;
+        *) echo "usage: $0 [-n runs] [-o outdir] [-b baseline.csv] [-m \"modes\"] [-c \"cases\"]" >&2; exit 1 ;;
+    esac
+done
+
+# generator options for each case; every case is fully determined by its seed
+case_args() {
+    case $1 in
+        decls_1k)        echo "--decls 1000 --statements 1000" ;;
+        arrays_1m)       echo "--arrays 4 --array-size 1000000 --statements 1000" ;;
+        statements_100k) echo "--statements 100000" ;;
+        depth_8)         echo "--depth 8 --statements 5000" ;;
+        branches_50)     echo "--branches 0.5 --statements 50000" ;;
+        *) echo "unknown case '$1'" >&2; exit 1 ;;
+    esac
+}
+
+mode_args() {
+    case $1 in
+        default) echo "" ;;
+        stats)   echo "--stats" ;;
+        profile) echo "--profile" ;;
+        perf)    echo "--perf" ;;
+        trace)   echo "--trace=$OUT/trace.json" ;;
+        *) echo "unknown mode '$1'" >&2; exit 1 ;;
+    esac
+}
+
+mkdir -p "$OUT"
+if [ -n "$BASELINE" ]; then
+    # the baseline may be an earlier results.csv in $OUT, which is rewritten below
+    cp "$BASELINE" "$OUT/baseline.csv"
+    BASELINE=$OUT/baseline.csv
+fi
+gcc -O2 -c lex.yy.c -o "$OUT/lex.yy.o"
+g++ -O2 parser.cpp "$OUT/lex.yy.o" -o "$OUT/parser"
+g++ -O2 bench/gen.cpp -o "$OUT/gen"
+
+CSV=$OUT/results.csv
+JSON=$OUT/results.json
+echo "case,mode,runs,bytes,median_ms,ci_low_ms,ci_high_ms" > "$CSV"
+
+for c in $CASES; do
+    "$OUT/gen" $(case_args "$c") --seed 1 > "$OUT/$c.txt"
+    bytes=$(wc -c < "$OUT/$c.txt")
+    for m in $MODES; do
+        args=$(mode_args "$m")
+        for ((r = 0; r < RUNS; r++)); do
+            start=$(date +%s%N)
+            if ! "$OUT/parser" $args < "$OUT/$c.txt" > /dev/null 2> "$OUT/run.err"; then
+                echo "$c/$m: the parser failed" >&2
+                head -5 "$OUT/run.err" >&2
+                exit 1
+            fi
+            end=$(date +%s%N)
+            echo "$(( (end - start) / 1000 ))"
+        done | sort -n | awk -v c="$c" -v m="$m" -v b="$bytes" '
+            { t[NR] = $1 / 1000.0 }
+            END {
+                n = NR
+                med = (n % 2) ? t[(n + 1) / 2] : (t[n / 2] + t[n / 2 + 1]) / 2
+                # distribution-free interval for the median from binomial order statistics
+                lo = int((n - 1.96 * sqrt(n)) / 2); if (lo < 1) lo = 1
+                hi = int(1 + (n + 1.96 * sqrt(n)) / 2 + 0.999); if (hi > n) hi = n
+                printf "%s,%s,%d,%d,%.3f,%.3f,%.3f\n", c, m, n, b, med, t[lo], t[hi]
+            }' >> "$CSV"
+        tail -1 "$CSV"
+    done
+done
+
+awk -F, 'NR > 1 {
+        printf "%s\n  {\"case\": \"%s\", \"mode\": \"%s\", \"runs\": %d, \"bytes\": %d, \"median_ms\": %s, \"ci_low_ms\": %s, \"ci_high_ms\": %s}", \
+            (NR > 2 ? "," : "["), $1, $2, $3, $4, $5, $6, $7
+    }
+    END { print (NR > 1 ? "\n]" : "[]") }' "$CSV" > "$JSON"
+echo "wrote $CSV and $JSON"
+
+if [ -n "$BASELINE" ]; then
+    awk -F, 'FNR == 1 { next }
+        NR == FNR { base[$1 "," $2] = $7; next }
+        ($1 "," $2) in base && $6 > base[$1 "," $2] {
+            printf "regression: %s/%s median %.3f ms, interval above baseline high %.3f ms\n", $1, $2, $5, base[$1 "," $2]
+            bad = 1
+        }
+        END { exit bad }' "$BASELINE" "$CSV"
+fi
@@ -0,0 +1,70 @@
+#!/bin/bash
+# Checks that lex.yy.c is what flex generates from scanner.l. flex copies
+# each rule's action and the %{ %} code into lex.yy.c after a
+# `#line N "scanner.l"` marker, so every such block must read the same as
+# scanner.l from line N on (the first line of an action follows its pattern
+# there). A change made to lex.yy.c alone, which the next `flex scanner.l`
+# would undo, shows up as a difference. When flex is installed, it also
+# regenerates lex.yy.c and checks that the result builds and gives the same
+# tokens on the sample programs.
+#
+# usage: bench/scanner_sync.sh [-o outdir]
+
+set -e
+cd "$(dirname "$0")/.."
+
+OUT=bench/out
+
+while getopts "o:" opt; do
+    case $opt in
+        o) OUT=$OPTARG ;;
+        *) echo "usage: $0 [-o outdir]" >&2; exit 1 ;;
+    esac
+done
+
+awk '
+    { sub(/\r$/, "") }
+    NR == FNR { source[FNR] = $0; next }
+    /^#line [0-9]+ "scanner.l"/ { line = $2; first = 1; copied = 1; next }
+    copied && (/^#line / || /^\tYY_BREAK$/ || /^case / || /^YY_RULE_SETUP$/) { copied = 0 }
+    # flex adds the default rule itself
+    copied && $0 == "ECHO;" { next }
+    copied {
+        want = source[line]
+        if (first)
+            same = length(want) >= length($0) && substr(want, length(want) - length($0) + 1) == $0
+        else
+            same = want == $0
+        if (!same) {
+            printf "lex.yy.c:%d differs from scanner.l:%d\n  lex.yy.c:  %s\n  scanner.l: %s\n", FNR, line, $0, want
+            bad = 1
+        }
+        line++
+        first = 0
+        checked++
+    }
+    END {
+        if (!bad)
+            printf "lex.yy.c matches scanner.l: %d copied lines\n", checked
+        exit bad
+    }' scanner.l lex.yy.c >&2
+
+if ! command -v flex > /dev/null; then
+    echo "flex is not installed; lex.yy.c was not regenerated" >&2
+    exit 0
+fi
+mkdir -p "$OUT/flex"
+flex -o "$OUT/flex/lex.yy.c" scanner.l
+gcc -O2 -I. -c lex.yy.c -o "$OUT/flex/shipped.o"
+gcc -O2 -I. -c "$OUT/flex/lex.yy.c" -o "$OUT/flex/regenerated.o"
+for name in shipped regenerated; do
+    g++ -std=gnu++17 -O2 parser.cpp "$OUT/flex/$name.o" -o "$OUT/flex/parser_$name" -lpthread
+done
+for f in test*.txt; do
+    if ! cmp -s <("$OUT/flex/parser_shipped" --dump-tokens < "$f" 2>&1) \
+                <("$OUT/flex/parser_regenerated" --dump-tokens < "$f" 2>&1); then
+        echo "the regenerated scanner lexes $f differently" >&2
+        exit 1
+    fi
+done
+echo "the regenerated scanner gives the same tokens on the samples" >&2
@@ -0,0 +1,98 @@
+#!/bin/bash
+# Checks and times --batch=steal on a corpus of tiny programs. 1000 programs
+# the size of test1.txt (test1.txt itself and generated ones) are listed over
+# and over, a million paths by default. First the samples, fuzzed input and
+# the first thousand paths of the corpus run with --batch=steal and with the
+# pipeline of --batch, and must give the same output and errors. Then the
+# whole corpus runs with --batch=steal on 1, 2, 4, ... threads up to the
+# number of cores, for programs per second and the speed-up over one thread,
+# and once with the pipeline on all of them. --stats on the widest run shows
+# how the chunks were shared out. Every option in the usage text must be
+# taken, or refused, by both modes alike.
+#
+# usage: bench/steal.sh [-n paths] [-c chunk] [-o outdir]
+
+set -e
+cd "$(dirname "$0")/.."
+
+PATHS=1000000
+CHUNK=64
+OUT=bench/out
+
+while getopts "n:c:o:" opt; do
+    case $opt in
+        n) PATHS=$OPTARG ;;
+        c) CHUNK=$OPTARG ;;
+        o) OUT=$OPTARG ;;
+        *) echo "usage: $0 [-n paths] [-c chunk] [-o outdir]" >&2; exit 1 ;;
+    esac
+done
+
+mkdir -p "$OUT/steal"
+gcc -O2 -c lex.yy.c -o "$OUT/lex.yy.o"
+g++ -std=gnu++17 -O2 parser.cpp "$OUT/lex.yy.o" -o "$OUT/parser" -lpthread
+g++ -O2 bench/gen.cpp -o "$OUT/gen"
+g++ -O2 bench/lexfuzz.cpp -o "$OUT/lexfuzz"
+
+rm -f "$OUT"/steal/*.txt
+for ((i = 1; i < 1000; i++)); do
+    "$OUT/gen" --statements $(( 3 + i % 8 )) --decls 3 --arrays 1 --array-size 5 --depth 1 --seed $i \
+        > "$OUT/steal/tiny$i.txt"
+done
+{ echo test1.txt; ls "$OUT"/steal/tiny*.txt; } > "$OUT/steal_tiny.list"
+awk -v n="$PATHS" '{ p[c++] = $0 } END { for (i = 0; i < n; i++) print p[i % c] }' \
+    "$OUT/steal_tiny.list" > "$OUT/steal_corpus.list"
+for seed in 1 2 3 4; do
+    "$OUT/lexfuzz" $seed 200 > "$OUT/steal/fuzz$seed.txt"
+done
+{ ls test*.txt; ls "$OUT"/steal/fuzz*.txt; head -1000 "$OUT/steal_corpus.list"; } > "$OUT/steal_check.list"
+
+"$OUT/parser" --batch < "$OUT/steal_check.list" > "$OUT/steal_pipeline.out" 2> "$OUT/steal_pipeline.err" || true
+for chunk in 1 7 "$CHUNK"; do
+    "$OUT/parser" --batch=steal --batch-chunk=$chunk < "$OUT/steal_check.list" \
+        > "$OUT/steal.out" 2> "$OUT/steal.err" || true
+    if ! cmp -s "$OUT/steal.out" "$OUT/steal_pipeline.out" || ! cmp -s "$OUT/steal.err" "$OUT/steal_pipeline.err"; then
+        echo "--batch=steal --batch-chunk=$chunk differs from --batch" >&2
+        diff "$OUT/steal.out" "$OUT/steal_pipeline.out" | head -10 >&2
+        diff "$OUT/steal.err" "$OUT/steal_pipeline.err" | head -10 >&2
+        exit 1
+    fi
+done
+echo "--batch=steal matches --batch: $(wc -l < "$OUT/steal_check.list") programs"
+
+# every option in the usage text must be taken, or refused, by both modes alike
+for opt in $("$OUT/parser" --help 2>&1 | grep -o -- '--[a-z-]*=\?' | sort -u); do
+    [[ $opt == --batch* ]] && continue
+    [[ $opt == *= ]] && opt+="$OUT/steal_option"
+    answers=$(for mode in --batch --batch=steal; do
+        "$OUT/parser" $mode "$opt" < /dev/null 2>&1 > /dev/null | grep -c "cannot be used with --batch"
+    done | sort -u | wc -l)
+    if [[ $answers != 1 ]]; then
+        echo "$opt is not handled alike by --batch and --batch=steal" >&2
+        exit 1
+    fi
+done
+echo "both batch modes take the same options"
+
+cores=$(nproc)
+timed() {
+    local start end
+    start=$(date +%s%N)
+    "$OUT/parser" "$@" < "$OUT/steal_corpus.list" > /dev/null
+    end=$(date +%s%N)
+    echo $(( (end - start) / 1000 ))
+}
+base=
+for ((t = 1; ; t *= 2)); do
+    (( t > cores )) && t=$cores
+    stats=
+    (( t == cores )) && stats=--stats
+    us=$(timed --batch=steal --batch-chunk="$CHUNK" --exec-threads=$t $stats)
+    base=${base:-$us}
+    awk -v t=$t -v us="$us" -v n="$PATHS" -v base="$base" \
+        'BEGIN { printf "steal    %3d threads: %9.0f programs/s, %5.2fx\n", t, n / (us / 1e6), base / us }'
+    (( t == cores )) && break
+done
+us=$(timed --batch --exec-threads="$cores")
+awk -v t="$cores" -v us="$us" -v n="$PATHS" -v base="$base" \
+    'BEGIN { printf "pipeline %3d threads: %9.0f programs/s, %5.2fx\n", t, n / (us / 1e6), base / us }'
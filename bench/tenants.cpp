@@ -0,0 +1,134 @@
+// Tail latency of short programs queued behind long ones on a
+// cinterp::Scheduler. For each quantum it submits the long programs, then
+// the short ones, and prints the latency of the short runs (submit to
+// callback) and the time until all runs have finished. Quantum 0 runs each
+// program to its end, like a plain thread pool. Every run's final values
+// are checked against a plain cinterp::run(). First, programs nested deeper
+// than a run's stack allows must end in a limit error rather than crash the
+// process.
+//
+// usage: tenants long.txt short.txt [longs] [shorts] [threads] [quanta...]
+#include <bits/stdc++.h>
+#include "../interpreter.h"
+
+using namespace std;
+
+string readFile(const char* path) {
+    ifstream in(path, ios::binary);
+    if (!in) {
+        fprintf(stderr, "cannot read %s\n", path);
+        exit(1);
+    }
+    return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+// every slot's final values, to compare runs
+vector<double> valuesOf(const cinterp::Instance& instance) {
+    vector<double> values;
+    const auto& slots = instance.program().slots();
+    for (int i = 0; i < (int)slots.size(); ++i) {
+        if (slots[i].type == cinterp::Type::Int && slots[i].isArray)
+            for (int32_t v : instance.intArray(i))
+                values.push_back(v);
+        else if (slots[i].type == cinterp::Type::Int)
+            values.push_back(instance.getInt(i));
+        else if (slots[i].isArray)
+            for (float v : instance.floatArray(i))
+                values.push_back(v);
+        else
+            values.push_back(instance.getFloat(i));
+    }
+    return values;
+}
+
+// as ==, but a NaN matches a NaN: generated programs can end with one
+bool sameValues(const vector<double>& a, const vector<double>& b) {
+    return equal(a.begin(), a.end(), b.begin(), b.end(), [](double x, double y) { return x == y || (x != x && y != y); });
+}
+
+// x = ((...(1)...)) with depth parentheses
+string nested(int depth) {
+    return "Program deep {\n    int x;\n    x = " + string(depth, '(') + "1" + string(depth, ')') + "\n}.\n";
+}
+
+// runs nested programs on schedulers with small and default stacks; one that
+// fits must give x = 1, and any other must stop with a limit error
+bool checkNesting() {
+    bool ok = true;
+    for (size_t stackSize : {(size_t)64 << 10, (size_t)256 << 10, cinterp::Scheduler::Options().stackSize}) {
+        cinterp::Scheduler::Options options;
+        options.stackSize = stackSize;
+        cinterp::Scheduler scheduler(options);
+        for (int depth : {5, 150, 180, 900, 5000, 100000}) {
+            cinterp::Program program = cinterp::compile(nested(depth));
+            scheduler.submit(program, {}, [&ok, stackSize, depth](cinterp::Instance* result, const cinterp::Error* error) {
+                bool fits = depth <= 5 || (depth <= 900 && stackSize >= (8 << 20));
+                bool right = result ? result->getInt(0) == 1 : error->kind == cinterp::ErrorKind::limit;
+                if (!right || fits != (result != nullptr)) {
+                    fprintf(stderr, "stack %zu KB, nested %d deep: %s\n", stackSize >> 10, depth,
+                            result ? "ran" : error->what());
+                    ok = false;
+                }
+            });
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s long.txt short.txt [longs] [shorts] [threads] [quanta...]\n", argv[0]);
+        return 1;
+    }
+    cinterp::Program longProgram = cinterp::compile(readFile(argv[1]));
+    cinterp::Program shortProgram = cinterp::compile(readFile(argv[2]));
+    int longs = argc > 3 ? atoi(argv[3]) : 4;
+    int shorts = argc > 4 ? atoi(argv[4]) : 200;
+    int threads = argc > 5 ? atoi(argv[5]) : 1;
+    vector<size_t> quanta;
+    for (int i = 6; i < argc; ++i)
+        quanta.push_back(strtoull(argv[i], nullptr, 10));
+    if (quanta.empty())
+        quanta = {0, 10000, 1000, 100};
+
+    if (!checkNesting())
+        return 1;
+    printf("nesting: deep programs stop with a limit error on 64 KB, 256 KB and default stacks\n");
+
+    vector<double> longExpected = valuesOf(cinterp::run(longProgram));
+    vector<double> shortExpected = valuesOf(cinterp::run(shortProgram));
+
+    using Clock = chrono::steady_clock;
+    for (size_t quantum : quanta) {
+        cinterp::Scheduler::Options options;
+        options.threads = threads;
+        options.quantum = quantum;
+        vector<double> latencies(shorts);
+        atomic<int> wrong{0};
+        Clock::time_point start = Clock::now();
+        {
+            cinterp::Scheduler scheduler(options);
+            for (int i = 0; i < longs; ++i) {
+                scheduler.submit(longProgram, {}, [&](cinterp::Instance* result, const cinterp::Error*) {
+                    wrong += !result || !sameValues(valuesOf(*result), longExpected);
+                });
+            }
+            for (int i = 0; i < shorts; ++i) {
+                Clock::time_point submitted = Clock::now();
+                scheduler.submit(shortProgram, {}, [&, i, submitted](cinterp::Instance* result, const cinterp::Error*) {
+                    latencies[i] = chrono::duration<double, micro>(Clock::now() - submitted).count();
+                    wrong += !result || !sameValues(valuesOf(*result), shortExpected);
+                });
+            }
+        }
+        double total = chrono::duration<double, milli>(Clock::now() - start).count();
+        if (wrong) {
+            fprintf(stderr, "quantum %zu: %d runs ended with other values than a plain run\n", quantum, wrong.load());
+            return 1;
+        }
+        sort(latencies.begin(), latencies.end());
+        printf("quantum %6zu: short runs p50 %9.1f us, p99 %9.1f us, max %9.1f us; all done in %.1f ms\n", quantum,
+               latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100], latencies.back(), total);
+    }
+    return 0;
+}
@@ -0,0 +1,34 @@
+#!/bin/bash
+# Builds the interpreter as a library and runs bench/tenants.cpp: short
+# programs queued behind long ones on a cinterp::Scheduler, for several
+# quanta, with the latency of the short runs.
+#
+# usage: bench/tenants.sh [-l longs] [-s shorts] [-t threads] [-o outdir]
+
+set -e
+cd "$(dirname "$0")/.."
+
+LONGS=4
+SHORTS=200
+THREADS=1
+OUT=bench/out
+
+while getopts "l:s:t:o:" opt; do
+    case $opt in
+        l) LONGS=$OPTARG ;;
+        s) SHORTS=$OPTARG ;;
+        t) THREADS=$OPTARG ;;
+        o) OUT=$OPTARG ;;
+        *) echo "usage: $0 [-l longs] [-s shorts] [-t threads] [-o outdir]" >&2; exit 1 ;;
+    esac
+done
+
+mkdir -p "$OUT"
+gcc -O2 -c lex.yy.c -o "$OUT/lex.yy.o"
+g++ -std=gnu++17 -O2 -DCINTERP_NO_MAIN -c parser.cpp -o "$OUT/interpreter.o"
+g++ -std=gnu++17 -O2 bench/tenants.cpp "$OUT/interpreter.o" "$OUT/lex.yy.o" -o "$OUT/tenants" -lpthread
+g++ -O2 bench/gen.cpp -o "$OUT/gen"
+
+"$OUT/gen" --statements 50000 --depth 3 --seed 1 > "$OUT/tenants_long.txt"
+"$OUT/gen" --statements 50 --depth 3 --seed 2 > "$OUT/tenants_short.txt"
+"$OUT/tenants" "$OUT/tenants_long.txt" "$OUT/tenants_short.txt" $LONGS $SHORTS $THREADS
@@ -0,0 +1,223 @@
+// C interface (cinterp.h) over the embedding API in interpreter.h. No
+// exception crosses into C: every entry point turns a failure into a status
+// and keeps its message for cinterp_last_error().
+#include <bits/stdc++.h>
+#include "cinterp.h"
+#include "interpreter.h"
+
+using namespace std;
+
+struct cinterp_program {
+    cinterp::Program program;
+};
+
+struct cinterp_run {
+    cinterp::Program program;
+    cinterp::Bindings bindings;
+    cinterp::Limits limits;
+    vector<vector<int32_t>> intArrays;  // copies the bindings point into
+    vector<vector<float>> floatArrays;
+    unique_ptr<cinterp::Instance> result;
+};
+
+thread_local string lastError;
+thread_local int lastErrorLine = 0;
+
+cinterp_status failWith(cinterp_status status, const string& message, int line = 0) {
+    lastError = message;
+    lastErrorLine = line;
+    return status;
+}
+
+cinterp_status statusOf(cinterp::ErrorKind kind) {
+    switch (kind) {
+        case cinterp::ErrorKind::lexical:  return CINTERP_ERROR_LEXICAL;
+        case cinterp::ErrorKind::syntax:   return CINTERP_ERROR_SYNTAX;
+        case cinterp::ErrorKind::semantic: return CINTERP_ERROR_SEMANTIC;
+        case cinterp::ErrorKind::usage:    return CINTERP_ERROR_USAGE;
+        case cinterp::ErrorKind::limit:    return CINTERP_ERROR_LIMIT;
+    }
+    return CINTERP_ERROR_INTERNAL;
+}
+
+template <typename Body>
+cinterp_status guarded(Body body) {
+    try {
+        body();
+        return CINTERP_OK;
+    } catch (const cinterp::Error& e) {
+        return failWith(statusOf(e.kind), e.what(), e.line);
+    } catch (const bad_alloc&) {
+        return failWith(CINTERP_ERROR_NO_MEMORY, "out of memory");
+    } catch (const exception& e) {
+        return failWith(CINTERP_ERROR_INTERNAL, e.what());
+    } catch (...) {
+        return failWith(CINTERP_ERROR_INTERNAL, "unknown error");
+    }
+}
+
+cinterp_status missing(const char* what) {
+    return failWith(CINTERP_ERROR_USAGE, string(what) + " is null");
+}
+
+const cinterp::Slot* slotAt(const cinterp_program* program, int slot) {
+    if (!program || slot < 0 || slot >= (int)program->program.slots().size())
+        return nullptr;
+    return &program->program.slots()[slot];
+}
+
+// the result of the last execute, or a usage error when there is none
+template <typename Read>
+cinterp_status readResult(const cinterp_run* run, const char* name, const void* out, Read read) {
+    if (!run || !name || !out)
+        return missing(!run ? "run" : !name ? "name" : "output");
+    if (!run->result)
+        return failWith(CINTERP_ERROR_USAGE, "the run has not executed successfully");
+    return guarded([&] { read(*run->result); });
+}
+
+extern "C" {
+
+int cinterp_abi_version(void) {
+    return CINTERP_ABI_VERSION;
+}
+
+cinterp_status cinterp_compile(const char* source, size_t length, cinterp_program** program) {
+    if (!source || !program)
+        return missing(!source ? "source" : "program");
+    *program = nullptr;
+    return guarded([&] {
+        auto compiled = make_unique<cinterp_program>();
+        compiled->program = cinterp::compile(string_view(source, length));
+        *program = compiled.release();
+    });
+}
+
+void cinterp_program_destroy(cinterp_program* program) {
+    delete program;
+}
+
+int cinterp_slot_count(const cinterp_program* program) {
+    return program ? (int)program->program.slots().size() : 0;
+}
+
+int cinterp_slot(const cinterp_program* program, const char* name) {
+    return program && name ? program->program.slot(name) : -1;
+}
+
+const char* cinterp_slot_name(const cinterp_program* program, int slot) {
+    const cinterp::Slot* s = slotAt(program, slot);
+    return s ? s->name.c_str() : nullptr;
+}
+
+cinterp_type cinterp_slot_type(const cinterp_program* program, int slot) {
+    const cinterp::Slot* s = slotAt(program, slot);
+    return s && s->type == cinterp::Type::Float ? CINTERP_FLOAT : CINTERP_INT;
+}
+
+int cinterp_slot_array_size(const cinterp_program* program, int slot) {
+    const cinterp::Slot* s = slotAt(program, slot);
+    return s ? s->arraySize : 0;
+}
+
+cinterp_run* cinterp_run_create(const cinterp_program* program) {
+    if (!program) {
+        missing("program");
+        return nullptr;
+    }
+    cinterp_run* run = new (nothrow) cinterp_run;
+    if (!run) {
+        failWith(CINTERP_ERROR_NO_MEMORY, "out of memory");
+        return nullptr;
+    }
+    run->program = program->program;
+    return run;
+}
+
+void cinterp_run_destroy(cinterp_run* run) {
+    delete run;
+}
+
+cinterp_status cinterp_set_int(cinterp_run* run, const char* name, int value) {
+    if (!run || !name)
+        return missing(!run ? "run" : "name");
+    return guarded([&] { run->bindings.set(name, value); });
+}
+
+cinterp_status cinterp_set_float(cinterp_run* run, const char* name, float value) {
+    if (!run || !name)
+        return missing(!run ? "run" : "name");
+    return guarded([&] { run->bindings.set(name, value); });
+}
+
+cinterp_status cinterp_set_int_array(cinterp_run* run, const char* name, const int32_t* values, size_t count) {
+    if (!run || !name || (!values && count))
+        return missing(!run ? "run" : !name ? "name" : "values");
+    return guarded([&] {
+        run->intArrays.emplace_back(values, values + count);
+        run->bindings.set(name, run->intArrays.back().data(), count);
+    });
+}
+
+cinterp_status cinterp_set_float_array(cinterp_run* run, const char* name, const float* values, size_t count) {
+    if (!run || !name || (!values && count))
+        return missing(!run ? "run" : !name ? "name" : "values");
+    return guarded([&] {
+        run->floatArrays.emplace_back(values, values + count);
+        run->bindings.set(name, run->floatArrays.back().data(), count);
+    });
+}
+
+cinterp_status cinterp_set_limits(cinterp_run* run, uint64_t max_steps, uint32_t timeout_ms) {
+    if (!run)
+        return missing("run");
+    run->limits = {max_steps, timeout_ms};
+    return CINTERP_OK;
+}
+
+cinterp_status cinterp_execute(cinterp_run* run) {
+    if (!run)
+        return missing("run");
+    run->result.reset();
+    return guarded([&] {
+        run->result = make_unique<cinterp::Instance>(cinterp::run(run->program, run->bindings, run->limits));
+    });
+}
+
+cinterp_status cinterp_get_int(const cinterp_run* run, const char* name, int* value) {
+    return readResult(run, name, value, [&](const cinterp::Instance& r) { *value = r.getInt(name); });
+}
+
+cinterp_status cinterp_get_float(const cinterp_run* run, const char* name, float* value) {
+    return readResult(run, name, value, [&](const cinterp::Instance& r) { *value = r.getFloat(name); });
+}
+
+cinterp_status cinterp_get_int_array(const cinterp_run* run, const char* name, const int32_t** values, size_t* count) {
+    if (!count)
+        return missing("count");
+    return readResult(run, name, values, [&](const cinterp::Instance& r) {
+        cinterp::ArrayView<int32_t> view = r.intArray(name);
+        *values = view.data;
+        *count = view.size;
+    });
+}
+
+cinterp_status cinterp_get_float_array(const cinterp_run* run, const char* name, const float** values, size_t* count) {
+    if (!count)
+        return missing("count");
+    return readResult(run, name, values, [&](const cinterp::Instance& r) {
+        cinterp::ArrayView<float> view = r.floatArray(name);
+        *values = view.data;
+        *count = view.size;
+    });
+}
+
+const char* cinterp_last_error(void) {
+    return lastError.c_str();
+}
+
+int cinterp_last_error_line(void) {
+    return lastErrorLine;
+}
+
+} // extern "C"
@@ -0,0 +1,103 @@
+#ifndef CINTERP_H
+#define CINTERP_H
+
+/*
+   C interface to the interpreter, built as libcinterp.so (see ReadMe.md).
+
+   A program is compiled once and can then be run any number of times, from
+   any number of threads at once. Each run is a separate object: set initial
+   values on it, execute it, read the final values, destroy it.
+
+       cinterp_program* program;
+       if (cinterp_compile(source, strlen(source), &program) != CINTERP_OK)
+           fprintf(stderr, "%s\n", cinterp_last_error());
+       cinterp_run* run = cinterp_run_create(program);
+       cinterp_set_int(run, "n", 10);
+       if (cinterp_execute(run) == CINTERP_OK)
+           cinterp_get_int(run, "total", &total);
+       cinterp_run_destroy(run);
+       cinterp_program_destroy(program);
+
+   Every function that can fail returns a status. The message of the most
+   recent failure on the calling thread is kept until its next failure.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define CINTERP_API __attribute__((visibility("default")))
+#else
+#define CINTERP_API
+#endif
+
+#define CINTERP_ABI_VERSION 1
+
+typedef enum {
+    CINTERP_OK = 0,
+    CINTERP_ERROR_LEXICAL,
+    CINTERP_ERROR_SYNTAX,
+    CINTERP_ERROR_SEMANTIC,
+    CINTERP_ERROR_USAGE,        /* unknown variable, wrong type or size, bad handle */
+    CINTERP_ERROR_NO_MEMORY,
+    CINTERP_ERROR_INTERNAL,
+    CINTERP_ERROR_LIMIT         /* more steps than max_steps, or past timeout_ms */
+} cinterp_status;
+
+typedef enum {
+    CINTERP_INT,
+    CINTERP_FLOAT
+} cinterp_type;
+
+typedef struct cinterp_program cinterp_program;
+typedef struct cinterp_run cinterp_run;
+
+/* CINTERP_ABI_VERSION of the library, to check against the header */
+CINTERP_API int cinterp_abi_version(void);
+
+CINTERP_API cinterp_status cinterp_compile(const char *source, size_t length, cinterp_program **program);
+CINTERP_API void cinterp_program_destroy(cinterp_program *program);
+
+/* declared variables, numbered in declaration order; -1 if not declared */
+CINTERP_API int cinterp_slot_count(const cinterp_program *program);
+CINTERP_API int cinterp_slot(const cinterp_program *program, const char *name);
+CINTERP_API const char *cinterp_slot_name(const cinterp_program *program, int slot);
+CINTERP_API cinterp_type cinterp_slot_type(const cinterp_program *program, int slot);
+CINTERP_API int cinterp_slot_array_size(const cinterp_program *program, int slot); /* 0 for scalars */
+
+/* a run keeps its program alive; the program may be destroyed first */
+CINTERP_API cinterp_run *cinterp_run_create(const cinterp_program *program);
+CINTERP_API void cinterp_run_destroy(cinterp_run *run);
+
+/* initial values, checked and applied when the run executes; arrays are
+   copied here */
+CINTERP_API cinterp_status cinterp_set_int(cinterp_run *run, const char *name, int value);
+CINTERP_API cinterp_status cinterp_set_float(cinterp_run *run, const char *name, float value);
+CINTERP_API cinterp_status cinterp_set_int_array(cinterp_run *run, const char *name, const int32_t *values, size_t count);
+CINTERP_API cinterp_status cinterp_set_float_array(cinterp_run *run, const char *name, const float *values, size_t count);
+
+/* limits for each execute; a step is a statement entered, 0 means no limit */
+CINTERP_API cinterp_status cinterp_set_limits(cinterp_run *run, uint64_t max_steps, uint32_t timeout_ms);
+
+CINTERP_API cinterp_status cinterp_execute(cinterp_run *run);
+
+/* final values, after an execute that succeeded; array pointers stay valid
+   until the run is executed again or destroyed */
+CINTERP_API cinterp_status cinterp_get_int(const cinterp_run *run, const char *name, int *value);
+CINTERP_API cinterp_status cinterp_get_float(const cinterp_run *run, const char *name, float *value);
+CINTERP_API cinterp_status cinterp_get_int_array(const cinterp_run *run, const char *name, const int32_t **values, size_t *count);
+CINTERP_API cinterp_status cinterp_get_float_array(const cinterp_run *run, const char *name, const float **values, size_t *count);
+
+/* the most recent failure on this thread: message ("" if none) and source line (0 if none) */
+CINTERP_API const char *cinterp_last_error(void);
+CINTERP_API int cinterp_last_error_line(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CINTERP_H */
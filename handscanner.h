@@ -0,0 +1,469 @@
+#ifndef HANDSCANNER_H
+#define HANDSCANNER_H
+
+// Hand-written scanner (--lexer=hand). It reproduces scanner.l token for token:
+// the same longest-match choice between its rules, the same quirks ("return"
+// is matched and dropped, "12.5" is NUM "12", DOT, NUM "5", "\r" counts as a
+// line of its own, keywords leave the column alone) and the same lexical
+// errors, reported through lexical_error() at the same line and column.
+// Unlike flex it keeps no global state, so any number can run at once, each
+// over its own chunk of one source (see the pre-scan at the end).
+//
+// Character classes are constexpr tables and keywords are found with a
+// perfect hash whose seed is searched for at compile time.
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "scanner.h"
+
+namespace handscanner {
+
+enum CharClass : uint8_t {
+    classLetter = 1,
+    classDigit = 2,
+    classBlank = 4,     // [ \t]
+    classIdJoin = 8,    // [@$_] before an identifier's trailing digits
+    classNumStop = 16,  // characters NUMERR excludes: [0-9 \t\n><=,;(){}[]+-*/]
+};
+
+constexpr std::array<uint8_t, 256> makeClasses() {
+    std::array<uint8_t, 256> classes{};
+    for (int c = 'a'; c <= 'z'; ++c)
+        classes[c] |= classLetter;
+    for (int c = 'A'; c <= 'Z'; ++c)
+        classes[c] |= classLetter;
+    for (int c = '0'; c <= '9'; ++c)
+        classes[c] |= classDigit | classNumStop;
+    for (unsigned char c : std::string_view(" \t"))
+        classes[c] |= classBlank;
+    for (unsigned char c : std::string_view("@$_"))
+        classes[c] |= classIdJoin;
+    for (unsigned char c : std::string_view(" \t\n><=,;(){}[]+-*/"))
+        classes[c] |= classNumStop;
+    return classes;
+}
+
+constexpr std::array<uint8_t, 256> charClasses = makeClasses();
+
+// tokens made of one character that never starts a longer one
+constexpr std::array<int8_t, 256> makeSingles() {
+    std::array<int8_t, 256> singles{};
+    for (auto& s : singles)
+        s = -1;
+    singles['{'] = LBRACE;    singles['}'] = RBRACE;
+    singles['('] = LPAREN;    singles[')'] = RPAREN;
+    singles['['] = LBRACKET;  singles[']'] = RBRACKET;
+    singles[';'] = SEMICOLON; singles[','] = COMMA;
+    singles['.'] = DOT;       singles['+'] = PLUS;
+    singles['-'] = MINUS;     singles['*'] = MUL;
+    return singles;
+}
+
+constexpr std::array<int8_t, 256> singleTokens = makeSingles();
+
+struct Keyword {
+    std::string_view text;
+    int token;  // -1: matched and dropped, as scanner.l does with "return"
+};
+
+constexpr Keyword keywords[] = {
+    {"Program", PROGRAM}, {"else", ELSE}, {"if", IF}, {"int", INT},
+    {"float", FLOAT}, {"return", -1}, {"void", VOID}, {"while", WHILE},
+};
+constexpr int keywordCount = sizeof(keywords) / sizeof(keywords[0]);
+constexpr unsigned keywordTableSize = 16;
+
+constexpr unsigned keywordHash(std::string_view word, unsigned seed) {
+    return ((unsigned char)word.front() * seed + (unsigned char)word.back() + word.size()) % keywordTableSize;
+}
+
+// smallest seed under which every keyword lands in its own slot
+constexpr unsigned findKeywordSeed() {
+    for (unsigned seed = 1; seed < 1000; ++seed) {
+        bool used[keywordTableSize] = {};
+        bool collides = false;
+        for (const Keyword& k : keywords) {
+            unsigned h = keywordHash(k.text, seed);
+            collides |= used[h];
+            used[h] = true;
+        }
+        if (!collides)
+            return seed;
+    }
+    return 0;
+}
+
+constexpr unsigned keywordSeed = findKeywordSeed();
+static_assert(keywordSeed != 0, "no perfect hash seed for the keywords");
+
+constexpr std::array<int8_t, keywordTableSize> makeKeywordSlots() {
+    std::array<int8_t, keywordTableSize> slots{};
+    for (auto& s : slots)
+        s = -1;
+    for (int i = 0; i < keywordCount; ++i)
+        slots[keywordHash(keywords[i].text, keywordSeed)] = i;
+    return slots;
+}
+
+constexpr std::array<int8_t, keywordTableSize> keywordSlots = makeKeywordSlots();
+
+// the keyword spelled by word, or nullptr
+inline const Keyword* findKeyword(std::string_view word) {
+    if (word.size() < 2 || word.size() > 7)
+        return nullptr;
+    int i = keywordSlots[keywordHash(word, keywordSeed)];
+    return i >= 0 && keywords[i].text == word ? &keywords[i] : nullptr;
+}
+
+// a lexical error kept for later (HandScanner::deferErrors)
+struct LexicalError {
+    const char* format = nullptr;   // scanner.l's message
+    std::string text;
+    int line = 0;
+    int column = 0;
+    bool characterFirst = false;    // the format takes text before line and column
+
+    std::string message(int lineOffset = 0) const {
+        char buffer[512];
+        if (characterFirst)
+            snprintf(buffer, sizeof(buffer), format, text.c_str(), line + lineOffset, column);
+        else
+            snprintf(buffer, sizeof(buffer), format, line + lineOffset, column, text.c_str());
+        std::string message = buffer;
+        message.pop_back(); // the newline
+        return message;
+    }
+};
+
+class HandScanner {
+public:
+    HandScanner(const char* data, size_t size) : p(data), end(data + size) {}
+
+    // the next token type, 0 at the end of input, like yylex(); text and
+    // length are the lexeme (yytext), line is yylineno
+    int next();
+
+    // for a chunk that starts inside a comment: skips to its end, false if
+    // the input ends first
+    bool skipOpenComment() { return skipComment(); }
+
+    const char* text = "";
+    size_t length = 0;
+    int line = 1;
+    int col = 1;        // where the scanner is; set it with line to start mid-source
+    int column = 1;     // col at the start of text
+
+    // a chunk that is not the end of the source: running out of input inside
+    // a comment is not an error
+    bool partial = false;
+    // keep the first lexical error in error instead of reporting it; failed
+    // is set from then on (clear it to keep the next one)
+    bool deferErrors = false;
+    bool failed = false;
+    LexicalError error;
+
+private:
+    const char* p;
+    const char* end;
+
+    bool is(const char* q, uint8_t mask) const {
+        return q < end && (charClasses[(unsigned char)*q] & mask);
+    }
+    bool at(const char* q, char c) const {
+        return q < end && *q == c;
+    }
+    const char* skip(const char* q, uint8_t mask) const {
+        while (is(q, mask))
+            ++q;
+        return q;
+    }
+    int token(int type, size_t n) {
+        column = col;
+        text = p;
+        length = n;
+        p += n;
+        col += (int)n;
+        return type;
+    }
+    int reject(const char* format, size_t n, bool characterFirst = false);
+    void report(const char* format, size_t n, bool characterFirst);
+    bool skipComment();
+    int word();
+    int number();
+};
+
+inline void HandScanner::report(const char* format, size_t n, bool characterFirst) {
+    if (failed)
+        return;
+    error = {format, std::string(p, n), line, col, characterFirst};
+    if (deferErrors) {
+        failed = true;
+        return;
+    }
+    if (characterFirst)
+        lexical_error(format, error.text.c_str(), line, col);
+    else
+        lexical_error(format, line, col, error.text.c_str());
+}
+
+inline int HandScanner::reject(const char* format, size_t n, bool characterFirst) {
+    report(format, n, characterFirst);
+    return token(UNKNOWN, n);
+}
+
+// after "/*"; false when the input ends inside the comment
+inline bool HandScanner::skipComment() {
+    for (;;) {
+        if (p == end) {
+            if (!partial)
+                report("Lexical Error: EOF reached while comment not closed at line %d, column %d\n", 0, false);
+            return false;
+        }
+        if (*p == '*' && at(p + 1, '/')) {
+            p += 2;
+            col += 2;
+            return true;
+        }
+        if (*p == '\n') {
+            ++line;
+            col = 1;
+        } else {
+            ++col;
+        }
+        ++p;
+    }
+}
+
+// a letter starts an ID, a keyword, or one of the two malformed-identifier rules
+inline int HandScanner::word() {
+    const char* alnumEnd = skip(p + 1, classLetter | classDigit);
+    const char* q = alnumEnd;
+    if (is(q, classIdJoin) && is(q + 1, classDigit))
+        q = skip(q + 2, classDigit);
+    size_t idLength = q - p;
+
+    size_t errorLength = 0;
+    if (at(alnumEnd, '#')) {
+        // {LETTER}({LETTER}|{DIGIT})*"#"({LETTER}|{DIGIT})*([@$_]?{DIGIT}+)?
+        const char* r = skip(alnumEnd + 1, classLetter | classDigit);
+        if (is(r, classIdJoin) && is(r + 1, classDigit))
+            r = skip(r + 2, classDigit);
+        errorLength = r - p;
+    } else if (is(alnumEnd, classIdJoin)) {
+        // {LETTER}({LETTER}|{DIGIT})*([@$_]?{DIGIT}*)"#"{DIGIT}*
+        const char* r = skip(alnumEnd + 1, classDigit);
+        if (at(r, '#'))
+            errorLength = skip(r + 1, classDigit) - p;
+    }
+    if (errorLength > idLength)
+        return reject("Lexical Error: Wrong identifier at line %d, column %d: %s\n", errorLength);
+
+    if (const Keyword* k = findKeyword(std::string_view(p, idLength))) {
+        column = col;
+        text = p;
+        length = idLength;
+        p += idLength;
+        if (k->token >= 0)
+            return k->token;
+        col += (int)idLength;
+        return -1;
+    }
+    return token(ID, idLength);
+}
+
+// a digit starts a NUM, a lone {DIGIT}, or a malformed number
+inline int HandScanner::number() {
+    const char* q = p + 1;
+    if (is(q, classDigit))
+        q = skip(q, classDigit);
+    else if (at(q, '.') && is(q + 1, classDigit))
+        q = skip(q + 1, classDigit);
+    else
+        return token(NUM, 1);
+
+    size_t numLength = q - p;
+    size_t errorLength = 0;
+    if (at(q, 'e') || at(q, 'E')) {
+        const char* r = q + 1;
+        if (at(r, '+') || at(r, '-'))
+            ++r;
+        if (is(r, classDigit))
+            numLength = skip(r, classDigit) - p;
+        else
+            errorLength = std::find_if(r, end, [](char c) {
+                return charClasses[(unsigned char)c] & classNumStop;
+            }) - p;
+    }
+    if (errorLength > numLength)
+        return reject("Lexical Error: Wrong number format at line %d, column %d: %s\n", errorLength);
+    return token(NUM, numLength);
+}
+
+inline int HandScanner::next() {
+    for (;;) {
+        if (p == end) {
+            column = col;
+            text = p;
+            length = 0;
+            return 0;
+        }
+        unsigned char c = *p;
+        uint8_t cls = charClasses[c];
+        int type;
+        if (cls & classLetter) {
+            type = word();
+            if (type < 0)
+                continue;   // "return"
+            return type;
+        }
+        if (cls & classDigit)
+            return number();
+        if (cls & classBlank) {
+            const char* q = skip(p, classBlank);
+            col += (int)(q - p);
+            p = q;
+            continue;
+        }
+        if (c == '\n' || c == '\r') {
+            ++line;
+            col = 1;
+            ++p;
+            continue;
+        }
+        if (singleTokens[c] >= 0)
+            return token(singleTokens[c], 1);
+        switch (c) {
+            case '/':
+                if (!at(p + 1, '*'))
+                    return token(DIV, 1);
+                p += 2;
+                col += 2;
+                if (!skipComment()) {
+                    column = col;
+                    text = p;
+                    length = 0;
+                    return 0;
+                }
+                continue;
+            case '<': return at(p + 1, '=') ? token(LTE, 2) : token(LT, 1);
+            case '>': return at(p + 1, '=') ? token(GTE, 2) : token(GT, 1);
+            case '=': return at(p + 1, '=') ? token(EQ, 2) : token(ASSIGN, 1);
+            case '!':
+                if (at(p + 1, '='))
+                    return token(NEQ, 2);
+                break;
+        }
+        return reject("Lexical Error: Unknown character '%s' at line %d, column %d\n", 1, true);
+    }
+}
+
+// Structural pre-scan for lexing one source in parallel chunks. A chunk ends
+// just after a newline, and a newline ends every token, so a chunk can be
+// lexed on its own once two things are known about the text before it:
+// whether it leaves a comment open and how many lines the scanner counted.
+// Both depend only on where comments open and close, which memchr finds far
+// faster than the scanner walks the text. Each chunk is scanned for both
+// possible starting states independently; resolveChunks then carries the
+// real state through them in order.
+
+struct Chunk {
+    const char* begin;
+    const char* end;
+    bool endsInComment[2];  // indexed by whether it starts in a comment
+    int lines[2];           // "\n" and, outside comments, "\r", likewise
+    bool inComment = false; // resolved starting state
+    int firstLine = 1;
+};
+
+// chunks of about target bytes, each ending after a newline
+inline std::vector<Chunk> splitChunks(const char* data, size_t size, size_t target) {
+    std::vector<Chunk> chunks;
+    const char* end = data + size;
+    for (const char* p = data; p < end || chunks.empty();) {
+        const char* q = end;
+        if ((size_t)(end - p) > target) {
+            if (const void* nl = memchr(p + target, '\n', end - p - target))
+                q = (const char*)nl + 1;
+        }
+        chunks.push_back({p, q, {}, {}});
+        p = q;
+    }
+    return chunks;
+}
+
+inline size_t countByte(const char* p, const char* end, char c) {
+    size_t n = 0;
+    while (const void* hit = memchr(p, c, end - p)) {
+        ++n;
+        p = (const char*)hit + 1;
+    }
+    return n;
+}
+
+inline void scanComments(Chunk& chunk) {
+    int newlines = (int)countByte(chunk.begin, chunk.end, '\n');
+    for (int start = 0; start < 2; ++start) {
+        bool inComment = start;
+        int lines = newlines;
+        const char* p = chunk.begin;
+        for (;;) {
+            if (inComment) {
+                // "*/" starting at or after p
+                const char* close = nullptr;
+                for (const char* q = p + 1; q < chunk.end; ++q) {
+                    q = (const char*)memchr(q, '/', chunk.end - q);
+                    if (!q)
+                        break;
+                    if (q[-1] == '*') {
+                        close = q;
+                        break;
+                    }
+                }
+                if (!close)
+                    break;
+                p = close + 1;
+                inComment = false;
+            } else {
+                const char* open = nullptr;
+                for (const char* q = p; q < chunk.end; ++q) {
+                    q = (const char*)memchr(q, '/', chunk.end - q);
+                    if (!q)
+                        break;
+                    if (q + 1 < chunk.end && q[1] == '*') {
+                        open = q;
+                        break;
+                    }
+                }
+                lines += (int)countByte(p, open ? open : chunk.end, '\r');
+                if (!open)
+                    break;
+                p = open + 2;
+                inComment = true;
+            }
+        }
+        chunk.endsInComment[start] = inComment;
+        chunk.lines[start] = lines;
+    }
+}
+
+inline void resolveChunks(std::vector<Chunk>& chunks) {
+    bool inComment = false;
+    int line = 1;
+    for (Chunk& chunk : chunks) {
+        chunk.inComment = inComment;
+        chunk.firstLine = line;
+        line += chunk.lines[inComment];
+        inComment = chunk.endsInComment[inComment];
+    }
+}
+
+} // namespace handscanner
+
+#endif // HANDSCANNER_H
@@ -0,0 +1,252 @@
+#ifndef INTERPRETER_H
+#define INTERPRETER_H
+
+// Embedding API. Build parser.cpp with -DCINTERP_NO_MAIN and link it with the
+// scanner to get the interpreter as a library:
+//
+//     cinterp::Program program = cinterp::compile(source);     // once
+//     cinterp::Bindings in;
+//     in.set("n", 10).set("weights", buffer, count);
+//     cinterp::Instance out = cinterp::run(program, in);       // many times
+//     int total = out.getInt("total");
+//
+// A Program is immutable once compiled; copies share it, and any number of
+// threads may run it at the same time. Each run executes on the calling
+// thread with its own symbol table. Errors that end the command-line
+// interpreter throw cinterp::Error here.
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cinterp {
+
+enum class ErrorKind {
+    lexical,    // the scanner rejected the source
+    syntax,     // the parser rejected it
+    semantic,   // undeclared variables, type errors, bad indices, division by zero
+    usage,      // the host asked for something the program doesn't have
+    limit       // the run went past its Limits, or nested too deep for its stack
+};
+
+class Error : public std::runtime_error {
+public:
+    Error(ErrorKind kind, int line, const std::string& message)
+        : std::runtime_error(message), kind(kind), line(line) {}
+
+    ErrorKind kind;
+    int line;   // 0 for usage errors
+};
+
+enum class Type {
+    Int, Float
+};
+
+// a declared variable; its position in Program::slots() is its slot number
+struct Slot {
+    std::string name;
+    Type type;
+    bool isArray;
+    int arraySize;  // 0 for scalars
+    int line;
+};
+
+struct CompiledProgram;
+class Bindings;
+class Instance;
+struct Limits;
+
+class Program {
+public:
+    const std::vector<Slot>& slots() const;
+    int slot(std::string_view name) const;  // -1 if not declared
+
+private:
+    friend Program compile(std::string_view source);
+    friend class Document;
+    friend class Instance;
+    friend Instance run(const Program& program, const Bindings& bindings, const Limits& limits);
+    std::shared_ptr<const CompiledProgram> impl;
+};
+
+// lexes the source and lays out its declarations; the statements are
+// checked as they run
+Program compile(std::string_view source);
+
+// initial values for variables, applied after the declarations. Arrays are
+// read from the host's buffer when run() starts and need not outlive it.
+class Bindings {
+public:
+    Bindings& set(std::string_view name, int value);
+    Bindings& set(std::string_view name, float value);
+    Bindings& set(std::string_view name, const int32_t* values, size_t count);
+    Bindings& set(std::string_view name, const float* values, size_t count);
+    Bindings& set(int slot, int value);
+    Bindings& set(int slot, float value);
+    Bindings& set(int slot, const int32_t* values, size_t count);
+    Bindings& set(int slot, const float* values, size_t count);
+
+    struct Binding {
+        std::string name;   // empty when bound by slot
+        int slot = -1;
+        Type type;
+        bool isArray;
+        int intValue = 0;
+        float floatValue = 0;
+        const void* values = nullptr;
+        size_t count = 0;
+    };
+    const std::vector<Binding>& entries() const { return bindings; }
+
+private:
+    std::vector<Binding> bindings;
+};
+
+template <typename T>
+struct ArrayView {
+    const T* data = nullptr;
+    size_t size = 0;
+
+    const T& operator[](size_t i) const { return data[i]; }
+    const T* begin() const { return data; }
+    const T* end() const { return data + size; }
+};
+
+// the final values of one run, as typed buffers owned by the instance;
+// unassigned scalars read as 0
+class Instance {
+public:
+    const Program& program() const { return compiled; }
+
+    int getInt(std::string_view name) const;
+    float getFloat(std::string_view name) const;
+    ArrayView<int32_t> intArray(std::string_view name) const;
+    ArrayView<float> floatArray(std::string_view name) const;
+    int getInt(int slot) const;
+    float getFloat(int slot) const;
+    ArrayView<int32_t> intArray(int slot) const;
+    ArrayView<float> floatArray(int slot) const;
+
+private:
+    friend Instance run(const Program& program, const Bindings& bindings, const Limits& limits);
+    friend class Document;
+    const Slot& checked(int slot, Type type, bool isArray) const;
+    void capture();     // the final values from this thread's interpreter
+
+    Program compiled;
+    std::vector<std::vector<int32_t>> ints;     // per slot; a scalar has one element
+    std::vector<std::vector<float>> floats;
+};
+
+// A run that enters more statements than maxSteps, or is still running
+// timeoutMs after it started, stops with an ErrorKind::limit error. Steps
+// count every statement entered, including those of a branch that is skipped.
+// 0 means no limit.
+struct Limits {
+    uint64_t maxSteps = 0;
+    uint32_t timeoutMs = 0;
+};
+
+Instance run(const Program& program, const Bindings& bindings = Bindings(), const Limits& limits = Limits());
+
+struct SchedulerState;
+
+// Runs many programs on a few threads. Each run is a coroutine with a stack
+// of its own, kept on the thread that starts it. It gives up that thread
+// every quantum statements, and the thread moves on to its next run in turn.
+// So a long program delays a short one queued behind it by a quantum at a
+// time, not by all of its own run time.
+//
+// Array bindings are read when the run starts, so they must stay valid until
+// its callback is called. A run's timeout counts from its start, including
+// the time other runs have its thread. Callbacks are called on the worker
+// threads; they may submit more runs, but must not wait().
+//
+// A stack is only reserved; a run uses the pages it touches. A program
+// nested deeper than a level per 4 KB of stackSize (1000 at most, as with
+// run()) stops with a limit error instead of overflowing it.
+class Scheduler {
+public:
+    struct Options {
+        int threads = 1;
+        size_t quantum = 1000;          // statements per turn; 0 runs each program to its end
+        size_t stackSize = 8 << 20;     // per run, while it is started and not finished
+    };
+    // exactly one of result and error is null
+    using Done = std::function<void(Instance* result, const Error* error)>;
+
+    Scheduler();
+    explicit Scheduler(const Options& options);
+    ~Scheduler();   // waits for the runs already submitted
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    void submit(const Program& program, Bindings bindings, Done done, const Limits& limits = Limits());
+    void wait();    // until every run submitted so far has called back
+
+private:
+    std::unique_ptr<SchedulerState> impl;
+};
+
+struct DocumentState;
+
+// A source being edited, for tools that check or run it as it is typed. Its
+// tokens are kept per unit: the program header, each declaration, each
+// top-level statement and the closing "} .". An edit re-lexes and re-parses
+// from the unit before it up to the first old unit that starts in the same
+// state, and keeps the rest, so its cost follows the size of the edit rather
+// than of the source.
+//
+// run() works the same way: after the first run, it executes again only the
+// statements an edit changed and those that read a value which is no longer
+// what it was in the run before, and keeps the recorded results of the rest.
+class Document {
+public:
+    explicit Document(std::string_view source);
+    ~Document();
+    Document(Document&&) noexcept;
+    Document& operator=(Document&&) noexcept;
+
+    // replaces length bytes at offset with text
+    void edit(size_t offset, size_t length, std::string_view text);
+    const std::string& source() const;
+
+    // the first lexical or syntax error, found without running anything. The
+    // statements are checked as if all of them ran, so a syntax error inside
+    // a branch that a run would skip is reported all the same.
+    std::optional<Error> check() const;
+
+    // compile(source()), from the tokens already at hand
+    Program compile() const;
+
+    // the final values of running the current source, the same as
+    // run(compile()) gives; the instance's program() holds the declarations
+    // only, for its slots
+    Instance run();
+
+    struct EditStats {
+        size_t tokensLexed = 0;
+        size_t unitsParsed = 0;
+        size_t unitsKept = 0;
+    };
+    EditStats lastEdit() const;
+
+    struct RunStats {
+        size_t statementsRun = 0;       // top-level statements executed
+        size_t statementsReused = 0;    // kept from the run before
+    };
+    RunStats lastRun() const;
+
+private:
+    std::unique_ptr<DocumentState> impl;
+};
+
+} // namespace cinterp
+
+#endif // INTERPRETER_H
@@ -866,8 +866,8 @@ case YY_STATE_EOF(COMMENT):
 #line 32 "scanner.l"
 {
     if (YY_START == COMMENT) {
-        fprintf(stderr, "Lexical Error: EOF reached while comment not closed at line %d, column %d\n", yylineno, col);
-        exit(1);
+        lexical_error("Lexical Error: EOF reached while comment not closed at line %d, column %d\n", yylineno, col);
+        BEGIN(INITIAL); return 0;
     }
     else {
         return 0; 
@@ -1031,36 +1031,36 @@ case 32:
 YY_RULE_SETUP
 #line 91 "scanner.l"
 {
-    fprintf(stderr, "Lexical Error: Wrong identifier at line %d, column %d: %s\n", yylineno, col, yytext);
+    lexical_error("Lexical Error: Wrong identifier at line %d, column %d: %s\n", yylineno, col, yytext);
     updateColumn();
-    exit(1);
+    return UNKNOWN;
 }
 	YY_BREAK
 case 33:
 YY_RULE_SETUP
 #line 96 "scanner.l"
 {
-    fprintf(stderr, "Lexical Error: Wrong identifier at line %d, column %d: %s\n", yylineno, col, yytext);
+    lexical_error("Lexical Error: Wrong identifier at line %d, column %d: %s\n", yylineno, col, yytext);
     updateColumn();
-    exit(1);
+    return UNKNOWN;
 }
 	YY_BREAK
 case 34:
 YY_RULE_SETUP
 #line 101 "scanner.l"
 {
-    fprintf(stderr, "Lexical Error: Wrong number format at line %d, column %d: %s\n", yylineno, col, yytext);
+    lexical_error("Lexical Error: Wrong number format at line %d, column %d: %s\n", yylineno, col, yytext);
     updateColumn();
-    exit(1);
+    return UNKNOWN;
 }
 	YY_BREAK
 case 35:
 YY_RULE_SETUP
 #line 106 "scanner.l"
 {
-    fprintf(stderr, "Lexical Error: Unknown character '%s' at line %d, column %d\n", yytext, yylineno, col);
+    lexical_error("Lexical Error: Unknown character '%s' at line %d, column %d\n", yytext, yylineno, col);
     updateColumn();
-    exit(1);
+    return UNKNOWN;
 }
 	YY_BREAK
 case 36:
@@ -1,14 +1,69 @@
 #include <iostream>
 #include <bits/stdc++.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <ucontext.h>
 #include "scanner.h"
+#include "interpreter.h"
+#include "handscanner.h"
 
 using namespace std; 
 
 extern "C" int yylex();
+extern "C" struct yy_buffer_state* yy_scan_bytes(const char* bytes, int len);
+extern "C" void yy_delete_buffer(struct yy_buffer_state* buffer);
+extern "C" int col;       // scanner's column, reported in lexical errors
 extern char* yytext;      // yytext contains the current token's string value
 extern int yylineno;      // yylineno contains the line number of the current token
 
-bool executeIf;
+// Interpreter state is per thread, so embedded programs (interpreter.h) can
+// run on several threads at once. Options set by main() stay process-wide.
+thread_local bool executeIf;
+
+// --stats: how many array accesses had an index built from literals only
+// versus one that depends on a variable. Both kinds are still compared
+// against the array's size when they run.
+bool statsMode = false;
+thread_local long long boundsChecksConstant = 0;
+thread_local long long boundsChecksVariable = 0;
+
+// Embedded, errors throw cinterp::Error; the command-line interpreter prints
+// them and exits.
+thread_local bool throwErrors = false;
+thread_local string pendingLexicalError;    // set by lexical_error() when embedded
+thread_local int pendingLexicalLine = 0;
+
+[[noreturn]] void fail(cinterp::ErrorKind kind, int line, const string& message) {
+    if (throwErrors)
+        throw cinterp::Error(kind, line, message);
+    cerr << message << endl;
+    exit(1);
+}
+
+extern "C" void lexical_error(const char* format, ...) {
+    char message[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    if (!throwErrors) {
+        fputs(message, stderr);
+        exit(1);
+    }
+    if (pendingLexicalError.empty()) {
+        pendingLexicalError = message;
+        pendingLexicalError.pop_back(); // the newline
+        pendingLexicalLine = yylineno;
+    }
+}
 
 const char* tokenTypeNames[] = {
     "PROGRAM", "INT", "FLOAT", "IF", "ELSE", "WHILE", "VOID", 
@@ -24,12 +79,13 @@ struct Token {
     TokenType type;
     string value;
     int line;
+    double number = 0; // NUM only, parsed once when the token is read
 
     Token(TokenType t, string v, int l) : type(t), value(v), line(l) {}
     Token() {}
 };
 
-Token currentToken; // Current token being processed
+thread_local Token currentToken; // Current token being processed
 
 // -------------------------------------- SYMBOL TABLE -----------------------------------
 enum enumType { 
@@ -45,9 +101,11 @@ struct Symbol {
     vector<string> values;
     int lineDeclared;
     int lastIndex = -1; // this will hold the index for when var_tail sees `[expr]`
+    bool isConst = false; // value comes from literals only, so its range is a single known point
 };
 
-unordered_map<string, Symbol> symbolTable;
+thread_local unordered_map<string, Symbol> symbolTable;
+thread_local vector<string> declarationOrder; // rebuilding the table in this order reproduces its iteration order
 
 void printSymbolTable() {
     cout << "\nSymbol Table:\n";
@@ -57,8 +115,7 @@ void printSymbolTable() {
 }
 
 void semantic_error(int line, const string &msg) {
-    cerr << "Semantic error at line " << line << ": " << msg << "\n";
-    exit(1);
+    fail(cinterp::ErrorKind::semantic, line, "Semantic error at line " + to_string(line) + ": " + msg);
 }
 
 void declareVariable(const string& name, enumType type, const string& initVal, int line, bool isArr = false, int arrSize = 0) {
@@ -75,6 +132,7 @@ void declareVariable(const string& name, enumType type, const string& initVal, i
     sym.values = vector<string>(arrSize, initVal);
     sym.lineDeclared = line;
     symbolTable[name] = sym;
+    declarationOrder.push_back(name);
 }
 
 Symbol& getVariable(const string& name, int line) {
@@ -86,17 +144,916 @@ Symbol& getVariable(const string& name, int line) {
 // -------------------------------------- ^^^ SYMBOL TABLE ^^^ -----------------------------------
 
 
+// ------------------------------------------ NUMBERS ------------------------------------------
+// Values are held as text, and these are the only conversions between text and
+// numbers. from_chars/to_chars ignore the locale and do not allocate, and
+// to_chars writes the shortest text that reads back as the same float, so a
+// float result prints the same on every run and re-reads exactly.
+
+// exponent forms ("12e3" is an int literal), fractions in an int context, and
+// inf/nan produced by float arithmetic
+double toDouble(string_view text) {
+    if (text.empty())
+        semantic_error(currentToken.line, "variable used before it was assigned a value");
+    double x = 0;
+    from_chars(text.data(), text.data() + text.size(), x);
+    return x;
+}
+
+int toInt(string_view text) {
+    int x;
+    auto [end, ec] = from_chars(text.data(), text.data() + text.size(), x);
+    if (ec == errc() && end == text.data() + text.size())
+        return x;
+    // truncates toward zero; converting a value an int cannot hold (or NaN)
+    // would be undefined, so that is an error instead
+    double d = toDouble(text);
+    if (!(d > INT_MIN - 1.0 && d < INT_MAX + 1.0))
+        semantic_error(currentToken.line, "value " + string(text) + " is out of range for int");
+    return (int)d;
+}
+
+float toFloat(string_view text) {
+    float x;
+    auto [end, ec] = from_chars(text.data(), text.data() + text.size(), x);
+    if (ec == errc() && end == text.data() + text.size())
+        return x;
+    return (float)toDouble(text);
+}
+
+string formatInt(int v) {
+    char buf[16];
+    return string(buf, to_chars(buf, buf + sizeof(buf), v).ptr);
+}
+
+// a whole number keeps a ".0" so the text still reads as a float literal
+string formatFloat(float v) {
+    char buf[32];
+    char* end = to_chars(buf, buf + sizeof(buf), v).ptr;
+    if (all_of(buf, end, [](char c) { return isdigit((unsigned char)c) || c == '-'; })) {
+        *end++ = '.';
+        *end++ = '0';
+    }
+    return string(buf, end);
+}
+
+// NUM literals are checked once, as they are read; a literal with a '.' is a
+// float, anything else an int
+bool parseLiteral(const string& text, double& value) {
+    double x = 0;
+    auto [end, ec] = from_chars(text.data(), text.data() + text.size(), x);
+    bool isFloat = text.find('.') != string::npos;
+    if (ec != errc() || (isFloat && fabs(x) > FLT_MAX) || (!isFloat && fabs(x) > INT_MAX))
+        return false;
+    value = isFloat ? x : trunc(x);
+    return true;
+}
+
+string literalRangeError(const string& text, int line) {
+    return "Lexical Error: number out of range at line " + to_string(line) + ": " + text;
+}
+
+double literalValue(const string& text, int line) {
+    double x;
+    if (!parseLiteral(text, x))
+        fail(cinterp::ErrorKind::lexical, line, literalRangeError(text, line));
+    return x;
+}
+// --------------------------------------- ^^^ NUMBERS ^^^ ---------------------------------------
+
+
+// ------------------------------------ STATEMENT DEPENDENCES ------------------------------------
+// --parallelism: record what each top-level statement reads and writes (scalars
+// by name, arrays per element) and report how much of the statement list could
+// run concurrently while producing the same final table as sequential order.
+// It is an analysis only: the statements still run one after another.
+
+struct StatementEffects {
+    explicit StatementEffects(int line) : line(line) {}
+
+    int line;
+    long long nanos = 0;
+    set<string> reads;
+    set<string> writes;
+};
+
+bool parallelismMode = false;
+thread_local int statementDepth = 0; // nesting of statement lists, 0 = program's own list
+vector<StatementEffects> statementEffects;
+
+string locationOf(const Symbol& sym) {
+    if (sym.lastIndex < 0)
+        return sym.name;
+    return sym.name + "[" + to_string(sym.lastIndex) + "]";
+}
+
+// Document::run re-executes single statements against the values of an
+// earlier run: it is told what each one reads and writes, and asked for the
+// value of a location (index -1 for a scalar) before the statement uses it.
+struct StatementObserver {
+    virtual void load(const string& name, int index) = 0;
+    virtual void read(const Symbol& sym) = 0;
+    virtual void write(const Symbol& sym) = 0;
+};
+
+thread_local StatementObserver* statementObserver = nullptr;
+
+void recordRead(const Symbol& sym) {
+    if (parallelismMode && !statementEffects.empty() && !sym.name.empty())
+        statementEffects.back().reads.insert(locationOf(sym));
+    if (statementObserver && !sym.name.empty())
+        statementObserver->read(sym);
+}
+
+void recordWrite(const Symbol& sym) {
+    if (parallelismMode && !statementEffects.empty())
+        statementEffects.back().writes.insert(locationOf(sym));
+    if (statementObserver)
+        statementObserver->write(sym);
+}
+
+
+void printParallelismReport() {
+    // earliest finish of each statement when it only waits for the statements
+    // it conflicts with (read-after-write, write-after-write, write-after-read),
+    // once weighted by measured time and once with every statement costing 1
+    struct LocationState {
+        int lastWriter = -1;
+        long long readersDoneNanos = 0;
+        long long readersDoneSteps = 0;
+    };
+    unordered_map<string, LocationState> locations;
+    vector<long long> doneNanos(statementEffects.size()), doneSteps(statementEffects.size());
+    long long totalNanos = 0, pathNanos = 0, pathSteps = 0;
+
+    for (size_t i = 0; i < statementEffects.size(); ++i) {
+        StatementEffects &st = statementEffects[i];
+        long long startNanos = 0, startSteps = 0;
+        for (const string& loc : st.reads) {
+            const LocationState &ls = locations[loc];
+            if (ls.lastWriter >= 0) {
+                startNanos = max(startNanos, doneNanos[ls.lastWriter]);
+                startSteps = max(startSteps, doneSteps[ls.lastWriter]);
+            }
+        }
+        for (const string& loc : st.writes) {
+            const LocationState &ls = locations[loc];
+            if (ls.lastWriter >= 0) {
+                startNanos = max(startNanos, doneNanos[ls.lastWriter]);
+                startSteps = max(startSteps, doneSteps[ls.lastWriter]);
+            }
+            startNanos = max(startNanos, ls.readersDoneNanos);
+            startSteps = max(startSteps, ls.readersDoneSteps);
+        }
+        doneNanos[i] = startNanos + st.nanos;
+        doneSteps[i] = startSteps + 1;
+
+        for (const string& loc : st.reads) {
+            LocationState &ls = locations[loc];
+            ls.readersDoneNanos = max(ls.readersDoneNanos, doneNanos[i]);
+            ls.readersDoneSteps = max(ls.readersDoneSteps, doneSteps[i]);
+        }
+        for (const string& loc : st.writes) {
+            LocationState &ls = locations[loc];
+            ls.lastWriter = (int)i;
+            ls.readersDoneNanos = 0;
+            ls.readersDoneSteps = 0;
+        }
+
+        totalNanos += st.nanos;
+        pathNanos = max(pathNanos, doneNanos[i]);
+        pathSteps = max(pathSteps, doneSteps[i]);
+    }
+
+    size_t n = statementEffects.size();
+    cerr << "=== Statement Parallelism ===\n"
+         << "top-level statements: " << n << "\n"
+         << "total work: " << totalNanos / 1000.0 << " us\n"
+         << "critical path: " << pathNanos / 1000.0 << " us, " << pathSteps << " statements\n";
+    if (pathNanos > 0 && pathSteps > 0) {
+        cerr << "available parallelism: " << (double)totalNanos / pathNanos << "x by time, "
+             << (double)n / pathSteps << "x by statement count\n";
+    }
+}
+// ---------------------------------- ^^^ STATEMENT DEPENDENCES ^^^ ---------------------------------
+
+
+// ------------------------------------------ PROFILER ------------------------------------------
+// --profile: count executions and accumulate time per source line and per kind
+// of statement. Frames form a call tree so the same data can be written out as
+// collapsed stacks ("program:1;if:12;assignment:12 <nanoseconds>").
+
+enum ProfileKind {
+    kindProgram, kindAssignment, kindCompound, kindIf, kindWhile, kindIndex
+};
+
+const char* profileKindNames[] = {
+    "program", "assignment", "compound", "if", "while", "index"
+};
+
+struct ProfileNode {
+    ProfileKind kind;
+    int line;
+    int parent;
+    int firstChild = -1;
+    int lastChild = -1;
+    int nextSibling = -1;
+    long long count = 0;
+    long long selfTicks = 0;
+};
+
+struct ProfileFrame {
+    int node;
+    long long start;
+    long long childTicks;
+};
+
+bool profileMode = false;
+string profileStacksPath; // --profile=FILE writes collapsed stacks here
+vector<ProfileNode> profileNodes; // node 0 is the root frame
+vector<ProfileFrame> profileStack;
+long long profileStartTicks, profileStartNanos;
+
+long long nowNanos() {
+    return chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// frames are timed in raw ticks and converted once in printProfile(); on x86
+// the TSC is several times cheaper to read than steady_clock
+long long profileTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return (long long)__builtin_ia32_rdtsc();
+#else
+    return nowNanos();
+#endif
+}
+
+void profileEnter(ProfileKind kind, int line) {
+    int parent = profileStack.empty() ? -1 : profileStack.back().node;
+    int found = -1;
+    if (parent < 0) {
+        if (!profileNodes.empty())
+            found = 0;
+    } else {
+        // straight-line code enters each child once, in source order, so only
+        // a revisit (a line seen before under this parent) walks the siblings
+        const ProfileNode &p = profileNodes[parent];
+        if (p.lastChild >= 0 && profileNodes[p.lastChild].line >= line) {
+            for (int c = p.firstChild; c >= 0; c = profileNodes[c].nextSibling) {
+                if (profileNodes[c].line == line && profileNodes[c].kind == kind) {
+                    found = c;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (found < 0) {
+        found = (int)profileNodes.size();
+        ProfileNode node;
+        node.kind = kind;
+        node.line = line;
+        node.parent = parent;
+        profileNodes.push_back(node);
+        if (parent >= 0) {
+            ProfileNode &p = profileNodes[parent];
+            if (p.lastChild >= 0)
+                profileNodes[p.lastChild].nextSibling = found;
+            else
+                p.firstChild = found;
+            p.lastChild = found;
+        }
+    }
+    profileStack.push_back({found, profileTicks(), 0});
+}
+
+void profileLeave() {
+    ProfileFrame frame = profileStack.back();
+    profileStack.pop_back();
+    long long total = profileTicks() - frame.start;
+    ProfileNode &node = profileNodes[frame.node];
+    node.count++;
+    node.selfTicks += total - frame.childTicks;
+    if (!profileStack.empty())
+        profileStack.back().childTicks += total;
+}
+
+struct ProfileScope {
+    bool active;
+    ProfileScope(ProfileKind kind, int line) : active(profileMode) {
+        if (active) profileEnter(kind, line);
+    }
+    ~ProfileScope() {
+        if (active) profileLeave();
+    }
+};
+
+ProfileKind profileKindOf(TokenType type) {
+    switch (type) {
+        case LBRACE: return kindCompound;
+        case IF:     return kindIf;
+        case WHILE:  return kindWhile;
+        default:     return kindAssignment;
+    }
+}
+
+void printProfile() {
+    double nanosPerTick = 1.0;
+    long long elapsedTicks = profileTicks() - profileStartTicks;
+    if (elapsedTicks > 0)
+        nanosPerTick = (double)(nowNanos() - profileStartNanos) / elapsedTicks;
+
+    struct Totals { long long count = 0; long long selfNanos = 0; };
+    int maxLine = 0;
+    for (const ProfileNode& node : profileNodes)
+        maxLine = max(maxLine, node.line);
+    vector<Totals> byLine(maxLine + 1);
+    Totals byKind[kindIndex + 1];
+    long long totalNanos = 0;
+    for (const ProfileNode& node : profileNodes) {
+        long long selfNanos = (long long)(node.selfTicks * nanosPerTick);
+        byLine[node.line].count += node.count;
+        byLine[node.line].selfNanos += selfNanos;
+        byKind[node.kind].count += node.count;
+        byKind[node.kind].selfNanos += selfNanos;
+        totalNanos += selfNanos;
+    }
+
+    vector<pair<int, Totals>> hot;
+    for (int line = 0; line <= maxLine; ++line) {
+        if (byLine[line].count)
+            hot.push_back({line, byLine[line]});
+    }
+    size_t shown = min<size_t>(hot.size(), 20);
+    partial_sort(hot.begin(), hot.begin() + shown, hot.end(), [](const auto& a, const auto& b) {
+        return a.second.selfNanos > b.second.selfNanos;
+    });
+
+    cerr << "=== Profile ===\n";
+    cerr << setw(8) << "line" << setw(12) << "count" << setw(14) << "self us" << setw(9) << "%" << "\n";
+    for (size_t i = 0; i < shown; ++i) {
+        cerr << setw(8) << hot[i].first
+             << setw(12) << hot[i].second.count
+             << setw(14) << fixed << setprecision(1) << hot[i].second.selfNanos / 1000.0
+             << setw(8) << (totalNanos ? 100.0 * hot[i].second.selfNanos / totalNanos : 0.0) << "%\n";
+    }
+    cerr << setw(12) << "kind" << setw(12) << "count" << setw(14) << "self us" << "\n";
+    for (int k = kindProgram; k <= kindIndex; ++k) {
+        cerr << setw(12) << profileKindNames[k]
+             << setw(12) << byKind[k].count
+             << setw(14) << byKind[k].selfNanos / 1000.0 << "\n";
+    }
+    cerr.unsetf(ios::floatfield);
+
+    if (!profileStacksPath.empty()) {
+        ofstream out(profileStacksPath);
+        if (!out) {
+            cerr << "Error: cannot write profile stacks to '" << profileStacksPath << "'\n";
+            return;
+        }
+        for (const ProfileNode& node : profileNodes) {
+            if (node.selfTicks <= 0)
+                continue;
+            vector<const ProfileNode*> frames;
+            for (const ProfileNode* n = &node; ; n = &profileNodes[n->parent]) {
+                frames.push_back(n);
+                if (n->parent < 0) break;
+            }
+            for (size_t i = frames.size(); i-- > 0; ) {
+                out << profileKindNames[frames[i]->kind] << ":" << frames[i]->line
+                    << (i ? ";" : " ");
+            }
+            out << (long long)(node.selfTicks * nanosPerTick) << "\n";
+        }
+    }
+}
+// ---------------------------------------- ^^^ PROFILER ^^^ ----------------------------------------
+
+
+// -------------------------------------------- TRACE --------------------------------------------
+// --trace=out.json: scoped spans for each phase in Chrome trace-event format
+// (load the file in chrome://tracing or Perfetto). Every thread gets its own
+// track, and records into a buffer of its own, so the threads of a --batch
+// take no lock per event. The file is written from an atexit handler so runs
+// that stop on an error still leave a trace behind.
+
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    long long start;
+    long long duration;
+    int thread;
+    int line;
+};
+
+struct TraceTrack {
+    int thread;
+    string name;
+    vector<TraceEvent> events;
+    long long dropped = 0;
+};
+
+string tracePath;
+const size_t traceEventLimit = 1000000; // per thread; one per token adds up on big inputs
+long long traceOrigin = 0;
+mutex traceLock;                // guards the list of tracks, not what is in them
+deque<TraceTrack> traceTracks;  // a deque, so a track never moves
+thread_local TraceTrack* traceTrack = nullptr;
+
+// the calling thread's track, named after it the first time
+TraceTrack& traceThread(const string& name = "") {
+    if (!traceTrack) {
+        lock_guard<mutex> lock(traceLock);
+        int thread = (int)traceTracks.size() + 1;
+        traceTrack = &traceTracks.emplace_back();
+        traceTrack->thread = thread;
+        traceTrack->name = !name.empty() ? name : thread == 1 ? "main" : "worker " + to_string(thread - 1);
+    }
+    return *traceTrack;
+}
+
+// names the calling thread's track, when there is a trace
+void nameTraceThread(const string& name) {
+    if (!tracePath.empty())
+        traceThread(name);
+}
+
+void traceSpan(const char* name, const char* category, long long start, int line = 0) {
+    TraceTrack& track = traceThread();
+    if (track.events.size() >= traceEventLimit) {
+        track.dropped++;
+        return;
+    }
+    track.events.push_back({name, category, start - traceOrigin, nowNanos() - start, track.thread, line});
+}
+
+struct TraceScope {
+    const char* name;
+    const char* category;
+    int line;
+    long long start;
+    TraceScope(const char* n, const char* c, int l = 0)
+        : name(n), category(c), line(l), start(tracePath.empty() ? 0 : nowNanos()) {}
+    ~TraceScope() {
+        if (!tracePath.empty())
+            traceSpan(name, category, start, line);
+    }
+};
+
+void writeTrace() {
+    ofstream out(tracePath);
+    if (!out) {
+        cerr << "Error: cannot write trace to '" << tracePath << "'\n";
+        return;
+    }
+    // every other thread has been joined by now
+    lock_guard<mutex> lock(traceLock);
+    out << "{\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"parser\"}}";
+    long long dropped = 0;
+    for (const TraceTrack& track : traceTracks) {
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track.thread
+            << ",\"args\":{\"name\":\"" << track.name << "\"}}";
+        dropped += track.dropped;
+    }
+    out << fixed << setprecision(3);
+    for (const TraceTrack& track : traceTracks) {
+        for (const TraceEvent& e : track.events) {
+            out << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"" << e.category
+                << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+                << ",\"ts\":" << e.start / 1000.0 << ",\"dur\":" << e.duration / 1000.0;
+            if (e.line > 0)
+                out << ",\"args\":{\"line\":" << e.line << "}";
+            out << "}";
+        }
+    }
+    out << "\n],\"otherData\":{\"droppedEvents\":" << dropped << "}}\n";
+}
+// ----------------------------------------- ^^^ TRACE ^^^ -----------------------------------------
+
+
+// --------------------------------------- PHASE COUNTERS ---------------------------------------
+// --perf: wall-clock time and hardware counters (perf_event_open) per phase.
+// Lexing, parsing and execution interleave, so phases nest: a token fetched
+// while an assignment runs is charged to lex, the rest of the assignment to
+// execute, and everything else inside program() to parse. When the counters
+// can't be opened (no PMU in a VM, perf_event_paranoid, non-Linux) only
+// wall-clock times are reported.
+
+enum Phase { phaseLex, phaseParse, phaseExecute, phaseOutput, phaseCount };
+const char* phaseNames[] = { "lex", "parse", "execute", "output" };
+
+struct HardwareCounter {
+    const char* name;
+    int fd = -1;
+};
+
+// the events behind them are in openHardwareCounters(), in the same order
+HardwareCounter hardwareCounters[] = {
+    { "cycles" }, { "instructions" }, { "branch-misses" }, { "L1d-misses" }, { "LLC-misses" },
+};
+const int hardwareCounterCount = sizeof(hardwareCounters) / sizeof(hardwareCounters[0]);
+
+bool perfMode = false;
+int perfGroup = -1;          // fd of the group leader, -1 when unavailable
+string perfUnavailable;      // why the counters could not be opened
+vector<Phase> phaseStack;
+long long phaseNanos[phaseCount];
+unsigned long long phaseCounts[phaseCount][hardwareCounterCount];
+long long lastSampleNanos;
+unsigned long long lastSample[hardwareCounterCount];
+
+void openHardwareCounters() {
+#ifdef __linux__
+    const unsigned long long l1dReadMiss = PERF_COUNT_HW_CACHE_L1D
+        | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    const pair<unsigned, unsigned long long> events[] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        { PERF_TYPE_HW_CACHE, l1dReadMiss },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    };
+    static_assert(size(events) == hardwareCounterCount, "one event per counter");
+    for (int i = 0; i < hardwareCounterCount; ++i) {
+        HardwareCounter& c = hardwareCounters[i];
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[i].first;
+        attr.config = events[i].second;
+        attr.read_format = PERF_FORMAT_GROUP;
+        attr.disabled = perfGroup < 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        c.fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, perfGroup, 0);
+        if (c.fd < 0 && perfGroup < 0) {
+            perfUnavailable = strerror(errno);
+            return;
+        }
+        if (perfGroup < 0)
+            perfGroup = c.fd;
+    }
+    ioctl(perfGroup, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(perfGroup, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+    perfUnavailable = "perf_event_open is Linux only";
+#endif
+}
+
+void readHardwareCounters(unsigned long long out[]) {
+#ifdef __linux__
+    if (perfGroup < 0)
+        return;
+    // PERF_FORMAT_GROUP: { nr, value[nr] } in the order the members were opened
+    unsigned long long buf[1 + hardwareCounterCount];
+    if (read(perfGroup, buf, sizeof(buf)) <= 0)
+        return;
+    for (int i = 0, v = 0; i < hardwareCounterCount; ++i) {
+        if (hardwareCounters[i].fd >= 0 && v < (int)buf[0])
+            out[i] = buf[1 + v++];
+    }
+#endif
+}
+
+// charge everything since the previous sample to the phase on top of the stack
+void samplePhase() {
+    long long now = nowNanos();
+    unsigned long long counts[hardwareCounterCount] = {};
+    readHardwareCounters(counts);
+    if (!phaseStack.empty()) {
+        Phase p = phaseStack.back();
+        phaseNanos[p] += now - lastSampleNanos;
+        for (int i = 0; i < hardwareCounterCount; ++i)
+            phaseCounts[p][i] += counts[i] - lastSample[i];
+    }
+    lastSampleNanos = now;
+    memcpy(lastSample, counts, sizeof(counts));
+}
+
+struct PhaseScope {
+    bool active;
+    PhaseScope(Phase p) : active(perfMode) {
+        if (!active) return;
+        samplePhase();
+        phaseStack.push_back(p);
+    }
+    ~PhaseScope() {
+        if (!active) return;
+        samplePhase();
+        phaseStack.pop_back();
+    }
+};
+
+void printPhaseCounters() {
+    cerr << "=== Phase Counters ===\n";
+    if (perfGroup < 0)
+        cerr << "hardware counters unavailable (" << perfUnavailable << "), wall-clock only\n";
+    cerr << setw(10) << "phase" << setw(12) << "wall ms";
+    if (perfGroup >= 0) {
+        for (const HardwareCounter& c : hardwareCounters) {
+            if (c.fd >= 0)
+                cerr << setw(15) << c.name;
+        }
+        cerr << setw(7) << "IPC";
+    }
+    cerr << "\n";
+    for (int p = 0; p < phaseCount; ++p) {
+        cerr << setw(10) << phaseNames[p] << setw(12) << fixed << setprecision(3) << phaseNanos[p] / 1e6;
+        if (perfGroup >= 0) {
+            for (int i = 0; i < hardwareCounterCount; ++i) {
+                if (hardwareCounters[i].fd >= 0)
+                    cerr << setw(15) << phaseCounts[p][i];
+            }
+            double cycles = (double)phaseCounts[p][0];
+            cerr << setw(7) << setprecision(2) << (cycles > 0 ? phaseCounts[p][1] / cycles : 0.0);
+        }
+        cerr << "\n";
+    }
+    cerr.unsetf(ios::floatfield);
+}
+// ------------------------------------ ^^^ PHASE COUNTERS ^^^ ------------------------------------
+
+
+// -------------------------------------- PARALLEL LEXING --------------------------------------
+// --lexer=parallel: the source is split into chunks at newlines, pre-scanned
+// for comment state and line numbers (handscanner.h), and the chunks are lexed
+// by the hand-written scanner on --lex-threads threads into one token buffer.
+// The parser then reads the buffer. A lexical error ends the buffer and is
+// reported when the parser reaches it, as it would be when scanning as it
+// parses, so whatever output comes before it is the same.
+
+int lexThreads = 0;     // 0: one per core
+size_t lexChunkBytes = 0;   // 0: chosen from the source size; small values test chunk boundaries
+
+thread_local string tokenStreamError;   // the error at the end of the token stream, if any
+thread_local int tokenStreamErrorLine = 0;
+
+// a chunk is scanned twice: once to count its tokens and find the first
+// lexical error, so the buffer can be allocated at its final size, and once
+// to write its tokens into their place in it
+struct LexedChunk {
+    size_t count = 0;       // tokens up to the end of the chunk or its first error
+    size_t offset = 0;      // of its first token in the buffer
+    string error;
+    int errorLine = 0;
+};
+
+handscanner::HandScanner chunkScanner(const handscanner::Chunk& chunk, bool last) {
+    handscanner::HandScanner scanner(chunk.begin, chunk.end - chunk.begin);
+    scanner.line = chunk.firstLine;
+    scanner.partial = !last;
+    scanner.deferErrors = true;
+    return scanner;
+}
+
+void countChunk(const handscanner::Chunk& chunk, bool last, LexedChunk& out) {
+    handscanner::HandScanner scanner = chunkScanner(chunk, last);
+    if (!chunk.inComment || scanner.skipOpenComment()) {
+        while ((scanner.next() != 0 || scanner.length > 0) && !scanner.failed)
+            out.count++;
+    }
+    out.count += last && !scanner.failed;   // the end-of-input token
+    if (scanner.failed) {
+        out.error = scanner.error.message();
+        out.errorLine = scanner.error.line;
+    }
+}
+
+// writes the chunk's tokens from tokens[out.offset]; a literal out of range
+// cuts the chunk short there, recorded like a scanner error
+void fillChunk(const handscanner::Chunk& chunk, bool last, Token* tokens, LexedChunk& out) {
+    handscanner::HandScanner scanner = chunkScanner(chunk, last);
+    if (chunk.inComment)
+        scanner.skipOpenComment();
+    Token* token = tokens + out.offset;
+    for (size_t i = 0; i < out.count; ++i, ++token) {
+        int type = scanner.next();
+        *token = Token((TokenType)type, string(scanner.text, scanner.length), scanner.line);
+        if (type == NUM && !parseLiteral(token->value, token->number)) {
+            out.count = i;
+            out.error = literalRangeError(token->value, token->line);
+            out.errorLine = token->line;
+            return;
+        }
+    }
+}
+
+// runs body(i) for i in [0, n) on up to threads threads
+template <typename Body>
+void parallelFor(size_t n, int threads, Body body) {
+    atomic<size_t> next{0};
+    auto worker = [&] {
+        for (size_t i; (i = next++) < n;)
+            body(i);
+    };
+    vector<thread> pool;
+    for (int t = 1; t < threads && (size_t)t < n; ++t)
+        pool.emplace_back(worker);
+    worker();
+    for (thread& t : pool)
+        t.join();
+}
+
+// the tokens of source, ending with the end-of-input token or, after a
+// lexical error, an UNKNOWN token that stands for it (tokenStreamError)
+vector<Token> lexParallel(const string& source) {
+    int threads = lexThreads > 0 ? lexThreads : max(1u, thread::hardware_concurrency());
+    // several chunks per thread to even out the load, but not so small that
+    // thread start-up dominates
+    size_t target = lexChunkBytes ? lexChunkBytes : max<size_t>(1 << 20, source.size() / (threads * 4) + 1);
+    vector<handscanner::Chunk> chunks = handscanner::splitChunks(source.data(), source.size(), target);
+
+    parallelFor(chunks.size(), threads, [&](size_t i) { handscanner::scanComments(chunks[i]); });
+    handscanner::resolveChunks(chunks);
+
+    vector<LexedChunk> lexed(chunks.size());
+    parallelFor(chunks.size(), threads, [&](size_t i) {
+        countChunk(chunks[i], i + 1 == chunks.size(), lexed[i]);
+    });
+    // nothing after the first error is needed
+    size_t used = 0;
+    size_t total = 0;
+    while (used < lexed.size()) {
+        lexed[used].offset = total;
+        total += lexed[used].count;
+        if (!lexed[used++].error.empty())
+            break;
+    }
+
+    vector<Token> tokens(total + 1);    // room for an error token
+    parallelFor(used, threads, [&](size_t i) {
+        fillChunk(chunks[i], i + 1 == chunks.size(), tokens.data(), lexed[i]);
+    });
+    size_t end = 0;
+    tokenStreamError.clear();
+    for (size_t i = 0; i < used; ++i) {
+        end = lexed[i].offset + lexed[i].count;
+        if (!lexed[i].error.empty()) {
+            tokenStreamError = lexed[i].error;
+            tokenStreamErrorLine = lexed[i].errorLine;
+            tokens[end++] = Token(UNKNOWN, "", lexed[i].errorLine);
+            break;
+        }
+    }
+    tokens.resize(end);
+    return tokens;
+}
+
+// the same tokens as lexParallel, on the calling thread, into a buffer that
+// keeps its capacity from one source to the next: for many small sources,
+// where splitting one up does not pay
+void lexInto(const string& source, vector<Token>& tokens) {
+    tokens.clear();
+    tokenStreamError.clear();
+    handscanner::HandScanner scanner(source.data(), source.size());
+    scanner.deferErrors = true;
+    for (;;) {
+        int type = scanner.next();
+        if (scanner.failed) {
+            tokenStreamError = scanner.error.message();
+            tokenStreamErrorLine = scanner.error.line;
+            break;
+        }
+        tokens.emplace_back((TokenType)type, string(scanner.text, scanner.length), scanner.line);
+        Token& token = tokens.back();
+        if (type == NUM && !parseLiteral(token.value, token.number)) {
+            tokenStreamError = literalRangeError(token.value, token.line);
+            tokenStreamErrorLine = token.line;
+            tokens.pop_back();
+            break;
+        }
+        if (type == 0 && scanner.length == 0)
+            return;
+    }
+    tokens.emplace_back(UNKNOWN, "", tokenStreamErrorLine);
+}
+// ----------------------------------- ^^^ PARALLEL LEXING ^^^ -----------------------------------
+
+
+// --checkpoint=FILE: every checkpointEvery top-level statements the state is
+// written to FILE; --resume=FILE restarts from it. The position is the number
+// of tokens consumed, so a resumed run re-scans the source up to that point.
+string checkpointPath;
+long long checkpointEvery = 1;
+thread_local long long statementsDone = 0;  // top-level statements completed
+thread_local long long tokensConsumed = 0;
+uint64_t sourceKey = 0;         // hash of the source and build, binds a checkpoint to its program
+void writeCheckpoint();
+
+// a compiled program's tokens; null when reading straight from the scanner
+thread_local const vector<Token>* tokenStream = nullptr;
+thread_local size_t tokenPosition = 0;
+
+// --lexer=hand: the hand-written scanner instead of flex
+thread_local handscanner::HandScanner* handScanner = nullptr;
+
+// Step metering, for --max-steps, --timeout-ms, cinterp::Limits and the
+// scheduler's quantum. statement() counts down to the next event: the step
+// past the budget, the next look at the clock, or the end of the quantum.
+// With nothing metered the count stays 0, and a statement pays one test.
+const size_t clockEvery = 1024;     // steps between looks at the clock
+const int maxNesting = 1000;        // statements and expressions inside each other
+
+struct Meter {
+    size_t left = 0;            // steps to the next event; 0 when none is due
+    size_t chunk = 0;           // what left counted down from
+    uint64_t steps = 0;         // entered up to the end of the last chunk
+    uint64_t maxSteps = 0;
+    uint32_t timeoutMs = 0;
+    long long deadline = 0;     // nowNanos(); 0 for none
+    size_t quantum = 0;         // cinterp::Scheduler; 0 outside one
+    size_t quantumLeft = 0;
+    int depth = 0;              // of NestingScope
+    int maxDepth = maxNesting;  // lower on a scheduler's smaller stacks
+};
+
+thread_local Meter meter;
+void yieldRun();
+
+void meterRefill() {
+    size_t next = SIZE_MAX;
+    if (meter.maxSteps)
+        next = (size_t)min<uint64_t>(next, meter.maxSteps + 1 - meter.steps);
+    if (meter.deadline)
+        next = min(next, clockEvery);
+    if (meter.quantum)
+        next = min(next, meter.quantumLeft);
+    meter.chunk = meter.left = next == SIZE_MAX ? 0 : next;
+}
+
+// starts counting a run's steps and time; 0 for no limit
+void setLimits(uint64_t maxSteps, uint32_t timeoutMs) {
+    meter.steps = 0;
+    meter.maxSteps = maxSteps;
+    meter.timeoutMs = timeoutMs;
+    meter.deadline = timeoutMs ? nowNanos() + timeoutMs * 1000000LL : 0;
+    meterRefill();
+}
+
+void meterEvent() {
+    meter.steps += meter.chunk;
+    if (meter.maxSteps && meter.steps > meter.maxSteps) {
+        fail(cinterp::ErrorKind::limit, currentToken.line, "Limit error at line " + to_string(currentToken.line)
+             + ": more than " + to_string(meter.maxSteps) + " steps");
+    }
+    if (meter.deadline && nowNanos() >= meter.deadline) {
+        fail(cinterp::ErrorKind::limit, currentToken.line, "Limit error at line " + to_string(currentToken.line)
+             + ": still running after " + to_string(meter.timeoutMs) + " ms");
+    }
+    bool turnOver = meter.quantum && (meter.quantumLeft -= meter.chunk) == 0;
+    if (turnOver)
+        meter.quantumLeft = meter.quantum;
+    meterRefill();
+    if (turnOver)
+        yieldRun();
+}
+
+// The rules recurse once per level of nesting, so a deep enough program would
+// run off the end of the stack and take the whole process down with it. Each
+// statement and expression holds one of these, which stops the run with a
+// limit error first.
+struct NestingScope {
+    NestingScope() {
+        if (++meter.depth > meter.maxDepth) {
+            meter.depth--;
+            fail(cinterp::ErrorKind::limit, currentToken.line, "Limit error at line " + to_string(currentToken.line)
+                 + ": nested more than " + to_string(meter.maxDepth) + " deep");
+        }
+    }
+    ~NestingScope() { meter.depth--; }
+};
+
 // this returns the next token from the tokens vector.
 Token getToken() {
-    int tokenType = yylex(); // Get next token from lexer
-    return Token((TokenType)tokenType, yytext, yylineno); // Set the value and line properly if needed
+    tokensConsumed++;
+    if (tokenStream) {
+        if (tokenPosition + 1 >= tokenStream->size() && !tokenStreamError.empty())
+            fail(cinterp::ErrorKind::lexical, tokenStreamErrorLine, tokenStreamError);
+        // the last token is the end of input, which repeats
+        return (*tokenStream)[min(tokenPosition++, tokenStream->size() - 1)];
+    }
+    TraceScope trace("yylex", "lex");
+    PhaseScope phase(phaseLex);
+    Token token;
+    if (handScanner) {
+        int tokenType = handScanner->next();
+        token = Token((TokenType)tokenType, string(handScanner->text, handScanner->length), handScanner->line);
+    } else {
+        int tokenType = yylex(); // Get next token from lexer
+        token = Token((TokenType)tokenType, yytext, yylineno); // Set the value and line properly if needed
+    }
+    if (token.type == NUM)
+        token.number = literalValue(token.value, token.line);
+    return token;
 }
 
 void error(const char* message) {
-    cerr << "Syntax error at line " << currentToken.line
-        << ": found '" << currentToken.value
-        << "'. " << message << std::endl;
-    exit(EXIT_FAILURE);
+    fail(cinterp::ErrorKind::syntax, currentToken.line,
+         "Syntax error at line " + to_string(currentToken.line)
+         + ": found '" + currentToken.value
+         + "'. " + message);
 }
 
 void match(TokenType expected) {
@@ -114,6 +1071,7 @@ void match(TokenType expected) {
 // ------------------------------- RULES ----------------------------------------------
 
 void program(); 
+void program_body();
 void declaration_list();
 void declaration_list_tail();
 void declaration();
@@ -134,7 +1092,7 @@ void selection_stmt();
 void selection_stmt_tail();
 void iteration_stmt();
 Symbol var();
-void var_tail(Symbol& sym);
+void var_tail(Symbol& sym, const vector<string>& elements);
 Symbol expression();
 Symbol expression_tail(Symbol term1);
 void relop();
@@ -161,8 +1119,20 @@ void program() // 1 - program -> Program ID {declaration-list statement-list}.
     match(DOT);
 }
 
+// entered instead of program() when the declarations are already in the
+// table: on --resume, whose checkpoints are only taken between two statements
+// of the program's own list, and when running a compiled program
+void program_body()
+{
+    statement_list();
+
+    match(RBRACE);
+    match(DOT);
+}
+
 void declaration_list() // 2.1 - declaration-list -> declaration declaration-list-tail
 {
+    TraceScope trace("declarations", "semantic", currentToken.line);
     declaration();
     declaration_list_tail();
 }
@@ -198,7 +1168,7 @@ void var_declaration_tail(const string &varName) // 4.2 - var-declaration-tail -
         match(SEMICOLON);
     } else if (currentToken.type == LBRACKET) { // THIS IS IF ITS AN ARRAY
         match(LBRACKET);
-        int size = stoi(currentToken.value);
+        int size = (int)currentToken.number;
         match(NUM);
         match(RBRACKET);
         match(SEMICOLON);
@@ -293,13 +1263,42 @@ void statement_list_tail() // 10.2 - statement-list-tail -> statement statement-
 {
     if (currentToken.type == ID || currentToken.type == LBRACE ||
         currentToken.type == IF || currentToken.type == WHILE) {
-        statement();
+        bool tracked = parallelismMode && statementDepth == 0;
+        chrono::steady_clock::time_point start;
+        if (tracked) {
+            statementEffects.emplace_back(currentToken.line);
+            start = chrono::steady_clock::now();
+        }
+
+        statementDepth++;
+        {
+            TraceScope trace(statementDepth == 1 ? "statement" : "nested statement", "execute", currentToken.line);
+            statement();
+        }
+        statementDepth--;
+
+        if (tracked) {
+            statementEffects.back().nanos = chrono::duration_cast<chrono::nanoseconds>(
+                chrono::steady_clock::now() - start).count();
+        }
+        if (statementDepth == 0 && !checkpointPath.empty()
+            && ++statementsDone % checkpointEvery == 0) {
+            writeCheckpoint();
+        }
         statement_list_tail();
     }
 }
 
 void statement() // 11 - statement -> assignment-stmt | compound-stmt | selection-stmt | iteration-stmt
 {
+    if (meter.left && --meter.left == 0)
+        meterEvent();
+    NestingScope nesting;
+    ProfileScope profile(profileKindOf(currentToken.type), currentToken.line);
+
+    // a skipped statement is parsed and its types checked, but nothing in it
+    // is evaluated: the values it would use need not exist, and a division by
+    // zero or a bad index there must not stop the run
     if (executeIf == false) {
         if (currentToken.type == ID) {
             Symbol dummy = var();
@@ -341,6 +1340,7 @@ void assignment_stmt() // 14 - assignment-stmt -> var = expression
 {   
     if (executeIf == true)
     { 
+        PhaseScope phase(phaseExecute);
         Symbol lhs = var();
         int opLine = currentToken.line;
         match(ASSIGN);
@@ -355,6 +1355,7 @@ void assignment_stmt() // 14 - assignment-stmt -> var = expression
                 " variable '" + lhs.name + "'");
         }
 
+        recordWrite(lhs);
         auto &entry = symbolTable[lhs.name];
         if (lhs.lastIndex < 0) {
             entry.value = rhs.value;
@@ -364,27 +1365,28 @@ void assignment_stmt() // 14 - assignment-stmt -> var = expression
     }
 }
 
+bool isTrue(const Symbol& cond) {
+    return toFloat(cond.value) != 0;
+}
+
+// both statements below are parsed either way; executeIf decides which one
+// runs, and is put back afterwards so a skipped `if` nested inside another
+// skipped statement stays skipped. Inside a skipped statement the condition
+// is not evaluated and neither branch runs.
 void selection_stmt() // 12.1 - selection-stmt -> if ( expression ) statement selection-stmt-tail
 {
-    if (executeIf == true)
-    { 
-        match(IF);
-        match(LPAREN);
-        expression();
-        match(RPAREN);
-        if (executeIf == true)
-        {
-            statement();
-            executeIf = false;
-            selection_stmt_tail();
-        }
-        else {
-            executeIf = false;
-            statement();
-            executeIf = true;
-            selection_stmt_tail();
-        }
-    }
+    bool enclosing = executeIf;
+    match(IF);
+    match(LPAREN);
+    Symbol cond = expression();
+    match(RPAREN);
+
+    bool taken = enclosing && isTrue(cond);
+    executeIf = taken;
+    statement();
+    executeIf = enclosing && !taken;
+    selection_stmt_tail();
+    executeIf = enclosing;
 }
 
 void selection_stmt_tail() // 12.2 - selection-stmt-tail -> else statement | ε
@@ -397,35 +1399,62 @@ void selection_stmt_tail() // 12.2 - selection-stmt-tail -> else statement | ε
 
 void iteration_stmt() // 13 - iteration-stmt -> while ( expression ) statement
 {
-    if (executeIf == true)
-    {
-        match(WHILE);
-        match(LPAREN);
-        expression();
-        match(RPAREN);
-        statement();
-    }
+    bool enclosing = executeIf;
+    match(WHILE);
+    match(LPAREN);
+    Symbol cond = expression();
+    match(RPAREN);
+
+    executeIf = enclosing && isTrue(cond);
+    statement();
+    executeIf = enclosing;
 }
 
 Symbol var() // 15.1 - var -> ID var-tail
 {
     string varName = currentToken.value;
-    Symbol varSymbol = getVariable(varName, currentToken.line);
+    const Symbol &entry = getVariable(varName, currentToken.line);
+    if (statementObserver && executeIf)
+        statementObserver->load(varName, -1);
     match(ID);
 
-    var_tail(varSymbol);
+    // copy the descriptor only: element storage stays in the table, so indexing
+    // a large array costs one element instead of the whole vector
+    Symbol varSymbol;
+    varSymbol.name = entry.name;
+    varSymbol.type = entry.type;
+    varSymbol.value = entry.value;
+    varSymbol.isArray = entry.isArray;
+    varSymbol.arraySize = entry.arraySize;
+    varSymbol.lineDeclared = entry.lineDeclared;
+
+    var_tail(varSymbol, entry.values);
     return varSymbol;
 
 }
 
-void var_tail(Symbol& sym) // 15.2 - var-tail -> [ expression ] | ε
+void var_tail(Symbol& sym, const vector<string>& elements) // 15.2 - var-tail -> [ expression ] | ε
 {
     if (currentToken.type == LBRACKET) {
+        ProfileScope profile(kindIndex, currentToken.line);
         match(LBRACKET);
         Symbol idxSym = expression(); 
-        int idx = stoi(idxSym.value);
+        if (executeIf == false) {
+            match(RBRACKET);
+            if (!sym.isArray)
+                semantic_error(sym.lineDeclared, "variable '" + sym.name + "' is not an array");
+            return;
+        }
+        int idx = toInt(idxSym.value);
         match(RBRACKET);
 
+        // a literal-only index has the range [idx, idx], known before the
+        // program runs; anything involving a variable is only known here
+        if (idxSym.isConst)
+            boundsChecksConstant++;
+        else
+            boundsChecksVariable++;
+
         if (!sym.isArray) {
             // error("Semantic error: " + sym.name + " is not an array");
             semantic_error(sym.lineDeclared, "variable '" + sym.name + "' is not an array");
@@ -435,12 +1464,15 @@ void var_tail(Symbol& sym) // 15.2 - var-tail -> [ expression ] | ε
         }
 
         sym.lastIndex = idx;
-        sym.value = sym.values[idx];
+        if (statementObserver)
+            statementObserver->load(sym.name, idx);
+        sym.value = elements[idx];
     }
 }
 
 Symbol expression() // 16.1 - expression -> additive-expression expression-tail
 {
+    NestingScope nesting;
     Symbol term1;
     Symbol result;
 
@@ -462,28 +1494,29 @@ Symbol expression_tail(Symbol term1) { // 16.2 - expression-tail -> relop additi
         match(op);
         Symbol term2 = additive_expression();
 
-        bool cond;
         // compare as ints (we only support integer relational results here)
         if (term1.type != term2.type)
             semantic_error(opLine, "mixed types in relational operator");
 
-        int lhs = stoi(term1.value), rhs = stoi(term2.value);
+        Symbol result;
+        if (executeIf) {
+            int lhs = toInt(term1.value), rhs = toInt(term2.value);
 
-        switch (op) {
-            case LT:  cond = lhs < hs; break;
-            case LTE: cond = lhs <= rhs; break;
-            case GT:  cond = lhs > rhs; break;
-            case GTE: cond = lhs >= rhs; break;
-            case EQ:  cond = lhs == rhs; break;
-            case NEQ: cond = lhs != rhs; break;
-            default:  cond = false; break;
+            bool cond;
+            switch (op) {
+                case LT:  cond = lhs < rhs; break;
+                case LTE: cond = lhs <= rhs; break;
+                case GT:  cond = lhs > rhs; break;
+                case GTE: cond = lhs >= rhs; break;
+                case EQ:  cond = lhs == rhs; break;
+                case NEQ: cond = lhs != rhs; break;
+                default:  cond = false; break;
+            }
+            result.value = cond ? "1" : "0";
         }
-        
-        executeIf = cond;
-        Symbol result;
-        result.value = cond ? "1" : "0";
         result.type = typeInt;
         result.name = "";
+        result.isConst = term1.isConst && term2.isConst;
         return expression_tail(result);
     }
     // ε-case: no comparison
@@ -530,11 +1563,13 @@ Symbol additive_expression_tail(Symbol term1) { // 18.2 - additive-expression-ta
         term2 = term();    
 
         if (term1.type == typeInt && term2.type == typeInt) {
-            result.value = to_string(stoi(term1.value) + stoi(term2.value));
+            if (executeIf)
+                result.value = formatInt(toInt(term1.value) + toInt(term2.value));
             result.type = typeInt;
         }
         else if (term1.type == typeFloat && term2.type == typeFloat) {
-            result.value = to_string(stof(term1.value) + stof(term2.value));
+            if (executeIf)
+                result.value = formatFloat(toFloat(term1.value) + toFloat(term2.value));
             result.type = typeFloat;
         }
         else {
@@ -547,6 +1582,7 @@ Symbol additive_expression_tail(Symbol term1) { // 18.2 - additive-expression-ta
         }
 
         result.name = "";
+        result.isConst = term1.isConst && term2.isConst;
         return additive_expression_tail(result);
     }
     else if (currentToken.type == MINUS) {
@@ -555,11 +1591,13 @@ Symbol additive_expression_tail(Symbol term1) { // 18.2 - additive-expression-ta
         term2 = term();     
 
         if (term1.type == typeInt && term2.type == typeInt) {
-            result.value = to_string(stoi(term1.value) - stoi(term2.value));
+            if (executeIf)
+                result.value = formatInt(toInt(term1.value) - toInt(term2.value));
             result.type = typeInt;
         }
         else if (term1.type == typeFloat && term2.type == typeFloat) {
-            result.value = to_string(stof(term1.value) - stof(term2.value));
+            if (executeIf)
+                result.value = formatFloat(toFloat(term1.value) - toFloat(term2.value));
             result.type = typeFloat;
         }
         else {
@@ -572,6 +1610,7 @@ Symbol additive_expression_tail(Symbol term1) { // 18.2 - additive-expression-ta
         }
 
         result.name = "";
+        result.isConst = term1.isConst && term2.isConst;
         return additive_expression_tail(result);
     }
 
@@ -613,10 +1652,12 @@ Symbol term_tail(Symbol term) { // 20.2 - term-tail -> mulop factor term-tail |
         Symbol result;
         if (op == MUL) {
             if (term.type == typeInt && rhs.type == typeInt) {
-                result.value = to_string(stoi(term.value) * stoi(rhs.value));
+                if (executeIf)
+                    result.value = formatInt(toInt(term.value) * toInt(rhs.value));
                 result.type = typeInt;
             } else if (term.type == typeFloat && rhs.type == typeFloat) {
-                result.value = to_string(stof(term.value) * stof(rhs.value));
+                if (executeIf)
+                    result.value = formatFloat(toFloat(term.value) * toFloat(rhs.value));
                 result.type = typeFloat;
             }
             else {
@@ -629,16 +1670,20 @@ Symbol term_tail(Symbol term) { // 20.2 - term-tail -> mulop factor term-tail |
             }
         } else { // DIV
             if (term.type == typeInt && rhs.type == typeInt) {
-                if (stoi(rhs.value) == 0) {
-                    semantic_error(opLine, "division by zero");
+                if (executeIf) {
+                    if (toInt(rhs.value) == 0) {
+                        semantic_error(opLine, "division by zero");
+                    }
+                    result.value = formatInt(toInt(term.value) / toInt(rhs.value));
                 }
-                result.value = to_string(stoi(term.value) / stoi(rhs.value));
                 result.type = typeInt;
             } else if (term.type == typeFloat && rhs.type == typeFloat) {
-                if (stof(rhs.value) == 0) {
-                    semantic_error(opLine, "division by zero");
+                if (executeIf) {
+                    if (toFloat(rhs.value) == 0) {
+                        semantic_error(opLine, "division by zero");
+                    }
+                    result.value = formatFloat(toFloat(term.value) / toFloat(rhs.value));
                 }
-                result.value = to_string(stof(term.value) / stof(rhs.value));
                 result.type = typeFloat;
             }
             else {
@@ -651,6 +1696,7 @@ Symbol term_tail(Symbol term) { // 20.2 - term-tail -> mulop factor term-tail |
             }
         }
         result.name = "";  
+        result.isConst = term.isConst && rhs.isConst;
         return term_tail(result);
     }
     // ε-case: just propagate the original term
@@ -677,6 +1723,8 @@ Symbol factor() // 22. factor -> ( expression ) | var | NUM
         match(RPAREN);
     } else if (currentToken.type == ID) {
         result = var();
+        if (executeIf)
+            recordRead(result);
     } else if (currentToken.type == NUM) {
         result.name = "";
         result.value = currentToken.value;
@@ -684,10 +1732,14 @@ Symbol factor() // 22. factor -> ( expression ) | var | NUM
         //     result.type = typeInt;
         // else
         //     result.type = typeFloat;
-        if (currentToken.value.find('.') != string::npos)
+        if (currentToken.value.find('.') != string::npos) {
             result.type = typeFloat;
-        else
+        } else {
             result.type = typeInt;
+            if (currentToken.value.find_first_of("eE") != string::npos)
+                result.value = formatInt((int)currentToken.number); // 12e3 is stored as 12000
+        }
+        result.isConst = true;
         match(NUM);
     } else {
         error("Expected '(', ID, or NUM");
@@ -699,42 +1751,3397 @@ Symbol factor() // 22. factor -> ( expression ) | var | NUM
 // ------------------------------- ^^^ RULES ^^^ ----------------------------------------
 
 
-int main() {
-    
-    executeIf = true;
+// ---------------------------------------- FINAL TABLE -----------------------------------------
 
-    currentToken = getToken(); // Initialize the first token
+// --format=text|sorted|json|binary. text is the original listing in table
+// order; the other formats list symbols sorted by name, so equal tables always
+// produce equal output.
+//
+// binary layout, native byte order, no padding:
+//   "CINTTABL"  u32 version  u32 byteOrderMark  u32 symbolCount
+//   per symbol: u8 type (0 int, 1 float)  u8 flags (1 array, 2 unassigned)
+//               u16 nameLength  u32 count  name  count x int32|float32
+enum OutputFormat {
+    formatText, formatSorted, formatJson, formatBinary
+};
 
-    if (currentToken.type == UNKNOWN) {
-        cerr << "Error: lexer couldn't initialize properly!" << endl;
-        return 1;
+OutputFormat outputFormat = formatText;
+
+bool textOutput() {
+    return outputFormat == formatText || outputFormat == formatSorted;
+}
+
+// --batch: a program's output is collected here instead of written to stdout
+thread_local string* outputCapture = nullptr;
+
+// stdout is written in large blocks: a huge array costs its formatting, not a
+// stream call per element
+struct OutputBuffer {
+    string data;
+
+    ~OutputBuffer() { flush(); }
+    static void write(const void* p, size_t size) {
+        if (outputCapture)
+            outputCapture->append((const char*)p, size);
+        else
+            fwrite(p, 1, size, stdout);
+    }
+    void flush() {
+        write(data.data(), data.size());
+        data.clear();
+    }
+    void put(string_view s) {
+        data.append(s);
+        if (data.size() >= (1 << 16))
+            flush();
+    }
+    void putRaw(const void* p, size_t size) {
+        if (size >= (1 << 16)) {
+            flush();
+            write(p, size);
+        } else {
+            put(string_view((const char*)p, size));
+        }
+    }
+    template <typename T>
+    void putValue(T v) { putRaw(&v, sizeof(v)); }
+};
+
+// a JSON number is written as is; anything else the interpreter can hold
+// ("", inf, nan) becomes null
+bool isJsonNumber(string_view v) {
+    size_t i = (!v.empty() && v[0] == '-') ? 1 : 0;
+    if (i >= v.size() || !isdigit((unsigned char)v[i]))
+        return false;
+    for (; i < v.size(); ++i) {
+        if (!isdigit((unsigned char)v[i]) && !strchr(".eE+-", v[i]))
+            return false;
+    }
+    return true;
+}
+
+// Entry is anything with name, type, isArray, arraySize and value(i), where
+// value(i) is element i of an array or the value of a scalar for i = 0; the
+// live table and a mapped program image both provide one
+template <typename Entry>
+void writeText(OutputBuffer& out, const Entry& e) {
+    const char* typeName = e.type == typeInt ? "int" : "float";
+    out.put(e.name);
+    if (!e.isArray) {
+        out.put(" = ");
+        out.put(e.value(0));
+    } else {
+        out.put("[");
+        out.put(to_string(e.arraySize));
+        out.put("] = { ");
+        for (int i = 0; i < e.arraySize; ++i) {
+            out.put(e.value(i));
+            out.put(i+1 < e.arraySize ? ", " : " ");
+        }
+        out.put("}");
+    }
+    out.put("  (type: ");
+    out.put(typeName);
+    out.put(")\n");
+}
+
+template <typename Entry>
+void writeJson(OutputBuffer& out, const Entry& e, bool first) {
+    auto value = [&](string_view v) { out.put(isJsonNumber(v) ? v : "null"); };
+    out.put(first ? "\n  " : ",\n  ");
+    out.put("{\"name\": \"");
+    out.put(e.name); // identifiers never need escaping
+    out.put(e.type == typeInt ? "\", \"type\": \"int\", " : "\", \"type\": \"float\", ");
+    if (!e.isArray) {
+        out.put("\"value\": ");
+        value(e.value(0));
+    } else {
+        out.put("\"size\": ");
+        out.put(to_string(e.arraySize));
+        out.put(", \"values\": [");
+        for (int i = 0; i < e.arraySize; ++i) {
+            if (i > 0)
+                out.put(", ");
+            value(e.value(i));
+        }
+        out.put("]");
+    }
+    out.put("}");
+}
+
+template <typename T>
+T binaryValue(string_view v) {
+    if (v.empty())
+        return 0; // unassigned
+    if constexpr (is_same_v<T, int32_t>)
+        return toInt(v);
+    else
+        return toFloat(v);
+}
+
+template <typename T, typename Entry>
+void writeBinaryValues(OutputBuffer& out, const Entry& e, uint32_t count) {
+    vector<T> values(count);
+    for (uint32_t i = 0; i < count; ++i)
+        values[i] = binaryValue<T>(e.value(i));
+    out.putRaw(values.data(), values.size() * sizeof(T));
+}
+
+template <typename Entry>
+void writeBinary(OutputBuffer& out, const Entry& e) {
+    uint32_t count = e.isArray ? max(e.arraySize, 0) : 1;
+    uint8_t flags = (e.isArray ? 1 : 0) | (!e.isArray && e.value(0).empty() ? 2 : 0);
+    out.putValue<uint8_t>(e.type == typeInt ? 0 : 1);
+    out.putValue<uint8_t>(flags);
+    out.putValue<uint16_t>((uint16_t)e.name.size());
+    out.putValue<uint32_t>(count);
+    out.put(e.name);
+    if (e.type == typeInt)
+        writeBinaryValues<int32_t>(out, e, count);
+    else
+        writeBinaryValues<float>(out, e, count);
+}
+
+template <typename Entry>
+void printTable(vector<Entry>& entries) {
+    if (outputFormat != formatText) {
+        sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+            return a.name < b.name;
+        });
+    }
+
+    OutputBuffer out;
+    if (textOutput()) {
+        out.put("=== Final Symbol Table ===\n");
+        for (const Entry& e : entries)
+            writeText(out, e);
+    } else if (outputFormat == formatJson) {
+        out.put("{\"symbols\": [");
+        for (size_t i = 0; i < entries.size(); ++i)
+            writeJson(out, entries[i], i == 0);
+        out.put(entries.empty() ? "]}\n" : "\n]}\n");
+    } else {
+        out.put("CINTTABL");
+        out.putValue<uint32_t>(1);
+        out.putValue<uint32_t>(0x01020304);
+        out.putValue<uint32_t>((uint32_t)entries.size());
+        for (const Entry& e : entries)
+            writeBinary(out, e);
     }
+}
+
+struct LiveEntry {
+    const Symbol* sym;
+    string_view name;
+    enumType type;
+    bool isArray;
+    int arraySize;
 
-    cout << "=== Running Parser + Interpreter ===\n";
-    program(); // Start parsing
-    cout << "Parsing completed successfully!" << endl;
+    LiveEntry(const Symbol& s)
+        : sym(&s), name(s.name), type(s.type), isArray(s.isArray), arraySize(s.arraySize) {}
+    string_view value(int i) const {
+        return isArray ? sym->values[i] : sym->value;
+    }
+};
 
-    cout << "=== Final Symbol Table ===\n";
+void printFinalTable() {
+    vector<LiveEntry> entries;
+    entries.reserve(symbolTable.size());
     for (const auto& [name, sym] : symbolTable) {
-        if (!sym.isArray) {
-            cout << name
-                << " = " << sym.value
-                << "  (type: " 
-                << (sym.type==typeInt ? "int" : "float")
-                << ")\n";
+        entries.emplace_back(sym);
+    }
+    printTable(entries);
+}
+// -------------------------------------- ^^^ FINAL TABLE ^^^ ---------------------------------------
+
+
+// ---------------------------------------- PROGRAM IMAGE ----------------------------------------
+// --cache=DIR: a program reads nothing but its own source, so its final symbol
+// table is a pure function of the source text. The table is stored as an image
+// under a hash of the source and the interpreter build. A warm run maps the
+// image read-only and prints straight from the mapped pages, with no scanning,
+// parsing or deserialization; concurrent runs of the same program share them.
+//
+// Every reference inside the image is an offset from the start of the file,
+// so it can be mapped at any address. Layout (native byte order, checked
+// through byteOrder), each section 8-byte aligned:
+//   ImageHeader
+//   slots     ImageSlot[slotCount], in the order the table is printed
+//   lines     int32[slotCount], line each slot was declared on
+//   elements  ImageString[elementCount], array elements
+//   pool      constant pool of names and values, each distinct string once
+// Checkpoints (--checkpoint) use the same image with kind imageCheckpoint, the
+// slots in declaration order, and the resume position filled in.
+
+const char imageMagic[8] = { 'C', 'I', 'N', 'T', 'C', 'A', 'C', 'H' };
+const uint32_t imageFormatVersion = 3;
+const uint32_t byteOrderMark = 0x01020304;
+const char* interpreterBuild = "parser " __DATE__ " " __TIME__;
+
+struct ImageString {
+    uint32_t offset;    // from the start of the pool
+    uint32_t length;
+};
+
+enum ImageKind : uint32_t {
+    imageResult, imageCheckpoint
+};
+
+struct ImageSlot {
+    ImageString name;
+    ImageString value;      // a scalar's value; kept for arrays too so a checkpoint loses nothing
+    uint32_t firstElement;
+    int32_t arraySize;
+    uint8_t type;
+    uint8_t isArray;
+    uint8_t reserved[2];
+};
+
+struct ImageHeader {
+    char magic[8];
+    uint32_t formatVersion;
+    uint32_t byteOrder;
+    uint64_t key;
+    uint64_t fileSize;
+    uint64_t checksum;      // FNV-1a of everything after the header
+    uint32_t slotCount;
+    uint32_t elementCount;
+    uint64_t slotsOffset;
+    uint64_t linesOffset;
+    uint64_t elementsOffset;
+    uint64_t poolOffset;
+    uint64_t poolSize;
+    uint32_t kind;
+    uint32_t executeIf;     // resume position, checkpoints only
+    uint64_t tokensConsumed;
+    uint64_t statementsDone;
+};
+
+string cacheDir;
+
+// into data, which keeps its capacity
+void readAll(FILE* in, string& data) {
+    data.clear();
+    char buf[1 << 16];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+        data.append(buf, n);
+}
+
+string readAll(FILE* in) {
+    string data;
+    readAll(in, data);
+    return data;
+}
+
+uint64_t fnv1a(const char* data, size_t size, uint64_t h = 14695981039346656037ull) {
+    for (size_t i = 0; i < size; ++i) {
+        h ^= (unsigned char)data[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+uint64_t cacheKey(const string& source) {
+    uint64_t h = fnv1a(interpreterBuild, strlen(interpreterBuild));
+    return fnv1a(source.data(), source.size(), h);
+}
+
+string cachePath(uint64_t key) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.cache", (unsigned long long)key);
+    return cacheDir + "/" + name;
+}
+
+uint64_t alignImage(uint64_t offset) {
+    return (offset + 7) & ~7ull;
+}
+
+// lays out an image of the given symbols, in that order
+string buildImage(uint64_t key, ImageKind kind, const vector<const Symbol*>& symbols) {
+    vector<ImageSlot> slots;
+    vector<int32_t> lines;
+    vector<ImageString> elements;
+    string pool;
+    unordered_map<string_view, ImageString> interned;
+
+    auto intern = [&](const string& str) {
+        auto it = interned.find(str);
+        if (it != interned.end())
+            return it->second;
+        ImageString ref{(uint32_t)pool.size(), (uint32_t)str.size()};
+        pool += str;
+        interned.emplace(str, ref); // views into the live table, which outlives this function
+        return ref;
+    };
+
+    for (const Symbol* sym : symbols) {
+        ImageSlot slot{};
+        slot.name = intern(sym->name);
+        slot.value = intern(sym->value);
+        slot.firstElement = (uint32_t)elements.size();
+        slot.arraySize = sym->arraySize;
+        slot.type = (uint8_t)sym->type;
+        slot.isArray = sym->isArray;
+        if (sym->isArray) {
+            for (int i = 0; i < sym->arraySize; ++i)
+                elements.push_back(intern(sym->values[i]));
         }
-        else {
-            cout << name
-                << "[" << sym.arraySize << "] = { ";
-            for (int i = 0; i < sym.arraySize; ++i) {
-            cout << sym.values[i]
-                << (i+1<sym.arraySize ? ", " : " ");
-            }
-            cout << "}  (type: " 
-                << (sym.type==typeInt ? "int" : "float")
-                << ")\n";
+        slots.push_back(slot);
+        lines.push_back(sym->lineDeclared);
+    }
+    if (pool.size() > UINT32_MAX || elements.size() > UINT32_MAX)
+        return ""; // offsets are 32-bit
+
+    ImageHeader header{};
+    memcpy(header.magic, imageMagic, sizeof(imageMagic));
+    header.formatVersion = imageFormatVersion;
+    header.byteOrder = byteOrderMark;
+    header.key = key;
+    header.kind = kind;
+    header.slotCount = (uint32_t)slots.size();
+    header.elementCount = (uint32_t)elements.size();
+    header.slotsOffset = alignImage(sizeof(ImageHeader));
+    header.linesOffset = alignImage(header.slotsOffset + slots.size() * sizeof(ImageSlot));
+    header.elementsOffset = alignImage(header.linesOffset + lines.size() * sizeof(int32_t));
+    header.poolOffset = alignImage(header.elementsOffset + elements.size() * sizeof(ImageString));
+    header.poolSize = pool.size();
+    header.fileSize = header.poolOffset + pool.size();
+    if (kind == imageCheckpoint) {
+        header.executeIf = executeIf;
+        header.tokensConsumed = tokensConsumed;
+        header.statementsDone = statementsDone;
+    }
+
+    string image(header.fileSize, '\0');
+    memcpy(&image[header.slotsOffset], slots.data(), slots.size() * sizeof(ImageSlot));
+    memcpy(&image[header.linesOffset], lines.data(), lines.size() * sizeof(int32_t));
+    memcpy(&image[header.elementsOffset], elements.data(), elements.size() * sizeof(ImageString));
+    memcpy(&image[header.poolOffset], pool.data(), pool.size());
+    header.checksum = fnv1a(image.data() + sizeof(ImageHeader), image.size() - sizeof(ImageHeader));
+    memcpy(&image[0], &header, sizeof(header));
+    return image;
+}
+
+// writes under a temporary name so a concurrent reader never sees half a file
+bool writeImage(const string& path, const string& image) {
+    if (image.empty())
+        return false;
+    string tmp = path + ".tmp" + to_string(getpid());
+    ofstream out(tmp, ios::binary);
+    out.write(image.data(), image.size());
+    out.close();
+    if (!out || rename(tmp.c_str(), path.c_str()) != 0) {
+        remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+void storeCachedResult(uint64_t key) {
+    vector<const Symbol*> symbols;
+    symbols.reserve(symbolTable.size());
+    for (const auto& [name, sym] : symbolTable)
+        symbols.push_back(&sym);
+
+    string path = cachePath(key);
+    if (!writeImage(path, buildImage(key, imageResult, symbols)))
+        cerr << "Warning: could not write cache entry '" << path << "'\n";
+}
+
+// a read-only mapping of an image; all accessors work on the mapped bytes
+struct MappedImage {
+    const char* base = nullptr;
+    size_t size = 0;
+
+    const ImageHeader& header() const { return *(const ImageHeader*)base; }
+    const ImageSlot& slot(uint32_t i) const {
+        return ((const ImageSlot*)(base + header().slotsOffset))[i];
+    }
+    int32_t line(uint32_t i) const {
+        return ((const int32_t*)(base + header().linesOffset))[i];
+    }
+    string_view str(ImageString s) const {
+        return string_view(base + header().poolOffset + s.offset, s.length);
+    }
+    string_view element(uint32_t i) const {
+        return str(((const ImageString*)(base + header().elementsOffset))[i]);
+    }
+
+    bool open(const string& path, uint64_t key, ImageKind kind);
+    bool valid(uint64_t key, ImageKind kind) const;
+    ~MappedImage() {
+        if (base) munmap((void*)base, size);
+    }
+};
+
+bool MappedImage::open(const string& path, uint64_t key, ImageKind kind) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ImageHeader)) {
+        close(fd);
+        return false;
+    }
+    void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return false;
+    base = (const char*)p;
+    size = st.st_size;
+    return valid(key, kind);
+}
+
+// header, checksum and every offset are checked before anything is printed
+bool MappedImage::valid(uint64_t key, ImageKind kind) const {
+    const ImageHeader& h = header();
+    if (memcmp(h.magic, imageMagic, sizeof(imageMagic)) != 0
+        || h.formatVersion != imageFormatVersion
+        || h.byteOrder != byteOrderMark
+        || h.key != key
+        || h.kind != kind
+        || h.fileSize != size) {
+        return false;
+    }
+    if (h.slotsOffset + (uint64_t)h.slotCount * sizeof(ImageSlot) > h.linesOffset
+        || h.linesOffset + (uint64_t)h.slotCount * sizeof(int32_t) > h.elementsOffset
+        || h.elementsOffset + (uint64_t)h.elementCount * sizeof(ImageString) > h.poolOffset
+        || h.poolOffset + h.poolSize > size
+        || h.slotsOffset < sizeof(ImageHeader)) {
+        return false;
+    }
+    if (fnv1a(base + sizeof(ImageHeader), size - sizeof(ImageHeader)) != h.checksum)
+        return false;
+
+    auto inPool = [&](ImageString s) { return (uint64_t)s.offset + s.length <= h.poolSize; };
+    for (uint32_t i = 0; i < h.slotCount; ++i) {
+        const ImageSlot& s = slot(i);
+        uint64_t count = s.isArray ? (uint64_t)max(s.arraySize, 0) : 0;
+        if (!inPool(s.name) || !inPool(s.value) || (uint64_t)s.firstElement + count > h.elementCount)
+            return false;
+    }
+    const ImageString* elements = (const ImageString*)(base + h.elementsOffset);
+    for (uint32_t i = 0; i < h.elementCount; ++i) {
+        if (!inPool(elements[i]))
+            return false;
+    }
+    return true;
+}
+
+// a slot of a mapped image, in the shape printTable expects
+struct ImageEntry {
+    const MappedImage* image;
+    const ImageSlot* slot;
+    string_view name;
+    enumType type;
+    bool isArray;
+    int arraySize;
+
+    ImageEntry(const MappedImage& m, const ImageSlot& s)
+        : image(&m), slot(&s), name(m.str(s.name)), type((enumType)s.type),
+          isArray(s.isArray), arraySize(s.arraySize) {}
+    string_view value(int i) const {
+        return isArray ? image->element(slot->firstElement + i) : image->str(slot->value);
+    }
+};
+
+// prints the cached table; false on a miss or an image that fails validation
+bool printCachedResult(uint64_t key) {
+    MappedImage image;
+    if (!image.open(cachePath(key), key, imageResult))
+        return false;
+
+    vector<ImageEntry> entries;
+    entries.reserve(image.header().slotCount);
+    for (uint32_t i = 0; i < image.header().slotCount; ++i) {
+        entries.emplace_back(image, image.slot(i));
+    }
+    if (textOutput()) {
+        cout << "=== Running Parser + Interpreter ===\n";
+        cout << "Parsing completed successfully!" << endl;
+    }
+    printTable(entries);
+    return true;
+}
+// ------------------------------------- ^^^ PROGRAM IMAGE ^^^ -------------------------------------
+
+
+// ----------------------------------------- CHECKPOINTS -----------------------------------------
+
+void writeCheckpoint() {
+    vector<const Symbol*> symbols;
+    symbols.reserve(declarationOrder.size());
+    for (const string& name : declarationOrder)
+        symbols.push_back(&symbolTable.at(name));
+
+    if (!writeImage(checkpointPath, buildImage(sourceKey, imageCheckpoint, symbols))) {
+        cerr << "Error: could not write checkpoint '" << checkpointPath << "'\n";
+        exit(1);
+    }
+}
+
+// rebuilds the table straight from the mapped checkpoint, then re-scans the
+// source up to the saved position; false if the file is not a checkpoint of
+// this program taken by this build
+bool restoreCheckpoint(const string& path) {
+    MappedImage image;
+    if (!image.open(path, sourceKey, imageCheckpoint))
+        return false;
+
+    const ImageHeader& h = image.header();
+    symbolTable.clear();
+    declarationOrder.clear();
+    for (uint32_t i = 0; i < h.slotCount; ++i) {
+        const ImageSlot& s = image.slot(i);
+        Symbol sym;
+        sym.name = image.str(s.name);
+        sym.type = (enumType)s.type;
+        sym.value = image.str(s.value);
+        sym.isArray = s.isArray;
+        sym.arraySize = s.arraySize;
+        sym.lineDeclared = image.line(i);
+        if (s.isArray) {
+            sym.values.reserve(s.arraySize);
+            for (int k = 0; k < s.arraySize; ++k)
+                sym.values.emplace_back(image.element(s.firstElement + k));
+        }
+        declarationOrder.push_back(sym.name);
+        symbolTable[sym.name] = move(sym);
+    }
+    executeIf = h.executeIf;
+    statementsDone = h.statementsDone;
+
+    long long position = h.tokensConsumed;
+    tokensConsumed = 0;
+    while (tokensConsumed < position) {
+        currentToken = getToken();
+        if (currentToken.type == PROGRAM && tokensConsumed > 1) // end of input before the position
+            return false;
+    }
+    return true;
+}
+// -------------------------------------- ^^^ CHECKPOINTS ^^^ --------------------------------------
+
+
+// ---------------------------------------- EMBEDDING API ----------------------------------------
+// interpreter.h. compile() lexes the whole source once, under a lock since the
+// flex scanner is a single global object, and runs the declarations to lay out
+// the slots. run() starts each instance from that table and executes the
+// statements from the stored tokens on the calling thread.
+
+namespace cinterp {
+
+struct CompiledProgram {
+    vector<Token> tokens;       // ends with the end-of-input token
+    size_t bodyStart = 0;       // first token after the declarations
+    vector<Symbol> declared;    // initial table, in declaration order
+    vector<Slot> slots;
+    unordered_map<string, int> slotOf;
+};
+
+// this thread's interpreter state, fresh for one compile or run
+struct EmbeddedState {
+    EmbeddedState(const vector<Token>* tokens, size_t start) {
+        throwErrors = true;
+        tokenStream = tokens;
+        tokenPosition = start;
+        symbolTable.clear();
+        declarationOrder.clear();
+        executeIf = true;
+        statementDepth = 0;
+        statementsDone = 0;
+        tokensConsumed = 0;
+        boundsChecksConstant = boundsChecksVariable = 0;
+        setLimits(0, 0);
+    }
+    ~EmbeddedState() {
+        throwErrors = false;
+        tokenStream = nullptr;
+        symbolTable.clear();
+        declarationOrder.clear();
+        setLimits(0, 0);
+    }
+};
+
+string describe(const Slot& s) {
+    string type = s.type == Type::Int ? "int" : "float";
+    return s.isArray ? type + "[" + to_string(s.arraySize) + "]" : type;
+}
+
+int slotNamed(const Program& program, string_view name) {
+    int slot = program.slot(name);
+    if (slot < 0)
+        throw Error(ErrorKind::usage, 0, "no variable '" + string(name) + "'");
+    return slot;
+}
+
+vector<Token> lex(string_view source) {
+    static mutex scannerLock;
+    lock_guard<mutex> lock(scannerLock);
+
+    struct Scan {
+        yy_buffer_state* buffer;
+        Scan(string_view source) : buffer(yy_scan_bytes(source.data(), (int)source.size())) {
+            throwErrors = true;
+            pendingLexicalError.clear();
+            yylineno = 1;
+            col = 1;
+        }
+        ~Scan() {
+            yy_delete_buffer(buffer);
+            throwErrors = false;
+        }
+    } scan(source);
+
+    // the scanner returns 0 at the end of input, which is also PROGRAM
+    vector<Token> tokens;
+    do {
+        tokens.push_back(getToken());
+    } while ((tokens.back().type != PROGRAM || tokens.back().value == "Program")
+             && pendingLexicalError.empty());
+    if (!pendingLexicalError.empty())
+        throw Error(ErrorKind::lexical, pendingLexicalLine, pendingLexicalError);
+    return tokens;
+}
+
+const vector<Slot>& Program::slots() const {
+    static const vector<Slot> none;
+    return impl ? impl->slots : none;
+}
+
+int Program::slot(string_view name) const {
+    if (!impl)
+        return -1;
+    auto it = impl->slotOf.find(string(name));
+    return it == impl->slotOf.end() ? -1 : it->second;
+}
+
+shared_ptr<const CompiledProgram> compileTokens(vector<Token> tokens) {
+    auto compiled = make_shared<CompiledProgram>();
+    compiled->tokens = move(tokens);
+
+    EmbeddedState state(&compiled->tokens, 0);
+    currentToken = getToken();
+    match(PROGRAM);
+    match(ID);
+    match(LBRACE);
+    declaration_list();
+    compiled->bodyStart = tokenPosition - 1; // currentToken is already read
+
+    for (const string& name : declarationOrder) {
+        const Symbol& sym = symbolTable.at(name);
+        compiled->slotOf[name] = (int)compiled->slots.size();
+        compiled->slots.push_back({name, sym.type == typeInt ? Type::Int : Type::Float,
+                                   sym.isArray, sym.arraySize, sym.lineDeclared});
+        compiled->declared.push_back(sym);
+    }
+
+    return compiled;
+}
+
+Program compile(string_view source) {
+    Program program;
+    program.impl = compileTokens(lex(source));
+    return program;
+}
+
+Bindings& Bindings::set(string_view name, int value) {
+    bindings.push_back({string(name), -1, Type::Int, false, value});
+    return *this;
+}
+
+Bindings& Bindings::set(string_view name, float value) {
+    bindings.push_back({string(name), -1, Type::Float, false, 0, value});
+    return *this;
+}
+
+Bindings& Bindings::set(string_view name, const int32_t* values, size_t count) {
+    bindings.push_back({string(name), -1, Type::Int, true, 0, 0, values, count});
+    return *this;
+}
+
+Bindings& Bindings::set(string_view name, const float* values, size_t count) {
+    bindings.push_back({string(name), -1, Type::Float, true, 0, 0, values, count});
+    return *this;
+}
+
+Bindings& Bindings::set(int slot, int value) {
+    bindings.push_back({"", slot, Type::Int, false, value});
+    return *this;
+}
+
+Bindings& Bindings::set(int slot, float value) {
+    bindings.push_back({"", slot, Type::Float, false, 0, value});
+    return *this;
+}
+
+Bindings& Bindings::set(int slot, const int32_t* values, size_t count) {
+    bindings.push_back({"", slot, Type::Int, true, 0, 0, values, count});
+    return *this;
+}
+
+Bindings& Bindings::set(int slot, const float* values, size_t count) {
+    bindings.push_back({"", slot, Type::Float, true, 0, 0, values, count});
+    return *this;
+}
+
+void bind(const Program& program, const Bindings::Binding& b) {
+    int slot = b.name.empty() ? b.slot : slotNamed(program, b.name);
+    if (slot < 0 || slot >= (int)program.slots().size())
+        throw Error(ErrorKind::usage, 0, "no slot " + to_string(slot));
+
+    const Slot& s = program.slots()[slot];
+    Slot given{s.name, b.type, b.isArray, (int)b.count, s.line};
+    if (s.type != b.type || s.isArray != b.isArray || (s.isArray && (size_t)s.arraySize != b.count))
+        throw Error(ErrorKind::usage, 0, "'" + s.name + "' is " + describe(s) + ", bound to " + describe(given));
+
+    Symbol& sym = symbolTable.at(s.name);
+    if (!b.isArray) {
+        sym.value = b.type == Type::Int ? formatInt(b.intValue) : formatFloat(b.floatValue);
+    } else if (b.type == Type::Int) {
+        const int32_t* values = (const int32_t*)b.values;
+        for (size_t i = 0; i < b.count; ++i)
+            sym.values[i] = formatInt(values[i]);
+    } else {
+        const float* values = (const float*)b.values;
+        for (size_t i = 0; i < b.count; ++i)
+            sym.values[i] = formatFloat(values[i]);
+    }
+}
+
+template <typename T>
+vector<T> typedValues(const Symbol& sym) {
+    if (!sym.isArray)
+        return { binaryValue<T>(sym.value) };
+    vector<T> values(sym.arraySize);
+    for (int i = 0; i < sym.arraySize; ++i)
+        values[i] = binaryValue<T>(sym.values[i]);
+    return values;
+}
+
+Instance run(const Program& program, const Bindings& bindings, const Limits& limits) {
+    if (!program.impl)
+        throw Error(ErrorKind::usage, 0, "run() needs a compiled program");
+    const CompiledProgram& compiled = *program.impl;
+
+    EmbeddedState state(&compiled.tokens, compiled.bodyStart);
+    for (const Symbol& sym : compiled.declared) {
+        declarationOrder.push_back(sym.name);
+        symbolTable.emplace(sym.name, sym);
+    }
+    for (const Bindings::Binding& b : bindings.entries())
+        bind(program, b);
+
+    setLimits(limits.maxSteps, limits.timeoutMs);
+    currentToken = getToken();
+    program_body();
+
+    Instance instance;
+    instance.compiled = program;
+    instance.capture();
+    return instance;
+}
+
+void Instance::capture() {
+    const vector<Slot>& slots = compiled.slots();
+    ints.assign(slots.size(), {});
+    floats.assign(slots.size(), {});
+    for (size_t i = 0; i < slots.size(); ++i) {
+        const Symbol& sym = symbolTable.at(slots[i].name);
+        if (sym.type == typeInt)
+            ints[i] = typedValues<int32_t>(sym);
+        else
+            floats[i] = typedValues<float>(sym);
+    }
+}
+
+const Slot& Instance::checked(int slot, Type type, bool isArray) const {
+    const vector<Slot>& slots = compiled.slots();
+    if (slot < 0 || slot >= (int)slots.size())
+        throw Error(ErrorKind::usage, 0, "no slot " + to_string(slot));
+    const Slot& s = slots[slot];
+    if (s.type != type || s.isArray != isArray) {
+        Slot asked{s.name, type, isArray, isArray ? s.arraySize : 0, s.line};
+        throw Error(ErrorKind::usage, 0, "'" + s.name + "' is " + describe(s) + ", read as " + describe(asked));
+    }
+    return s;
+}
+
+int Instance::getInt(int slot) const {
+    checked(slot, Type::Int, false);
+    return ints[slot][0];
+}
+
+float Instance::getFloat(int slot) const {
+    checked(slot, Type::Float, false);
+    return floats[slot][0];
+}
+
+ArrayView<int32_t> Instance::intArray(int slot) const {
+    checked(slot, Type::Int, true);
+    return { ints[slot].data(), ints[slot].size() };
+}
+
+ArrayView<float> Instance::floatArray(int slot) const {
+    checked(slot, Type::Float, true);
+    return { floats[slot].data(), floats[slot].size() };
+}
+
+int Instance::getInt(string_view name) const {
+    return getInt(slotNamed(compiled, name));
+}
+
+float Instance::getFloat(string_view name) const {
+    return getFloat(slotNamed(compiled, name));
+}
+
+ArrayView<int32_t> Instance::intArray(string_view name) const {
+    return intArray(slotNamed(compiled, name));
+}
+
+ArrayView<float> Instance::floatArray(string_view name) const {
+    return floatArray(slotNamed(compiled, name));
+}
+
+} // namespace cinterp
+// ------------------------------------- ^^^ EMBEDDING API ^^^ -------------------------------------
+
+
+// ------------------------------------------ SCHEDULER ------------------------------------------
+// cinterp::Scheduler. Each worker thread keeps its runs in a ready queue and
+// resumes the one at the front with swapcontext until it yields (the meter
+// ends its quantum) or finishes, then puts it at the back. The
+// interpreter state is thread_local, so a switch swaps all of it with the
+// copy the run keeps; a run never moves to another thread, since code may
+// hold on to the address of a thread_local across the switch.
+
+namespace cinterp {
+
+// the thread_local interpreter state a run takes with it
+struct RunState {
+    bool executeIf = true;
+    long long boundsChecksConstant = 0, boundsChecksVariable = 0;
+    bool throwErrors = false;
+    string pendingLexicalError;
+    int pendingLexicalLine = 0;
+    Token currentToken;
+    unordered_map<string, Symbol> symbolTable;
+    vector<string> declarationOrder;
+    int statementDepth = 0;
+    StatementObserver* statementObserver = nullptr;
+    string tokenStreamError;
+    int tokenStreamErrorLine = 0;
+    long long statementsDone = 0, tokensConsumed = 0;
+    const vector<Token>* tokenStream = nullptr;
+    size_t tokenPosition = 0;
+    handscanner::HandScanner* handScanner = nullptr;
+    Meter meter;
+
+    // exchanges this with the thread's; twice restores both
+    void swapIn() {
+        swap(executeIf, ::executeIf);
+        swap(boundsChecksConstant, ::boundsChecksConstant);
+        swap(boundsChecksVariable, ::boundsChecksVariable);
+        swap(throwErrors, ::throwErrors);
+        pendingLexicalError.swap(::pendingLexicalError);
+        swap(pendingLexicalLine, ::pendingLexicalLine);
+        swap(currentToken, ::currentToken);
+        symbolTable.swap(::symbolTable);
+        declarationOrder.swap(::declarationOrder);
+        swap(statementDepth, ::statementDepth);
+        swap(statementObserver, ::statementObserver);
+        tokenStreamError.swap(::tokenStreamError);
+        swap(tokenStreamErrorLine, ::tokenStreamErrorLine);
+        swap(statementsDone, ::statementsDone);
+        swap(tokensConsumed, ::tokensConsumed);
+        swap(tokenStream, ::tokenStream);
+        swap(tokenPosition, ::tokenPosition);
+        swap(handScanner, ::handScanner);
+        swap(meter, ::meter);
+    }
+};
+
+struct Worker;
+
+struct Task {
+    Program program;
+    Bindings bindings;
+    Scheduler::Done done;
+    Limits limits;
+    Worker* worker;
+    char* stack = nullptr;      // null until it starts
+    ucontext_t context;
+    RunState state;
+    bool finished = false;
+    optional<Instance> result;
+    optional<Error> error;
+};
+
+struct Worker {
+    SchedulerState* scheduler;
+    std::thread runner;
+    mutex lock;
+    condition_variable wake;
+    vector<unique_ptr<Task>> submitted;     // under lock
+    bool stopping = false;                  // under lock
+    atomic<size_t> load{0};                 // runs given to it and not finished
+    ucontext_t context;
+    vector<char*> stacks;                   // free ones
+
+    void loop();
+    void resume(Task& task);
+    void finish(unique_ptr<Task> task);
+};
+
+struct SchedulerState {
+    Scheduler::Options options;
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    vector<unique_ptr<Worker>> workers;
+    mutex lock;
+    condition_variable idle;
+    size_t unfinished = 0;  // under lock
+
+    char* allocateStack(Worker& worker) {
+        if (!worker.stacks.empty()) {
+            char* stack = worker.stacks.back();
+            worker.stacks.pop_back();
+            return stack;
         }
+        // a guard page below the stack turns an overflow into a crash
+        void* p = mmap(nullptr, options.stackSize + pageSize, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+        if (p == MAP_FAILED)
+            throw bad_alloc();
+        mprotect(p, pageSize, PROT_NONE);
+        return (char*)p;
+    }
+    void freeStacks(Worker& worker) {
+        for (char* stack : worker.stacks)
+            munmap(stack, options.stackSize + pageSize);
+        worker.stacks.clear();
+    }
+};
+
+thread_local Task* runningTask = nullptr;
+
+void runTask() {
+    Task& task = *runningTask;
+    try {
+        task.result = run(task.program, task.bindings, task.limits);
+    } catch (const Error& e) {
+        task.error = e;
+    } catch (const exception& e) {
+        // out of memory and the like; nothing may unwind past this frame
+        task.error = Error(ErrorKind::usage, 0, e.what());
+    }
+    task.finished = true;
+    // returns to uc_link, the worker
+}
+
+void Worker::resume(Task& task) {
+    if (!task.stack) {
+        task.stack = scheduler->allocateStack(*this);
+        getcontext(&task.context);
+        task.context.uc_stack.ss_sp = task.stack + scheduler->pageSize;
+        task.context.uc_stack.ss_size = scheduler->options.stackSize;
+        task.context.uc_link = &context;
+        makecontext(&task.context, runTask, 0);
+    }
+    runningTask = &task;
+    task.state.swapIn();
+    swapcontext(&context, &task.context);
+    task.state.swapIn();
+    runningTask = nullptr;
+}
+
+void Worker::finish(unique_ptr<Task> task) {
+    stacks.push_back(task->stack);
+    load--;
+    task->done(task->result ? &*task->result : nullptr, task->error ? &*task->error : nullptr);
+    task.reset();
+    lock_guard<mutex> guard(scheduler->lock);
+    if (--scheduler->unfinished == 0)
+        scheduler->idle.notify_all();
+}
+
+void Worker::loop() {
+    deque<unique_ptr<Task>> ready;
+    for (;;) {
+        {
+            unique_lock<mutex> guard(lock);
+            wake.wait(guard, [&] { return !ready.empty() || !submitted.empty() || stopping; });
+            for (auto& task : submitted)
+                ready.push_back(move(task));
+            submitted.clear();
+            if (ready.empty())
+                break;
+        }
+        unique_ptr<Task> task = move(ready.front());
+        ready.pop_front();
+        resume(*task);
+        if (task->finished)
+            finish(move(task));
+        else
+            ready.push_back(move(task));
+    }
+}
+
+} // namespace cinterp
+
+// called from statement() when the run's quantum is used up
+void yieldRun() {
+    cinterp::Task& task = *cinterp::runningTask;
+    swapcontext(&task.context, &task.worker->context);
+}
+
+namespace cinterp {
+
+Scheduler::Scheduler() : Scheduler(Options()) {}
+
+Scheduler::Scheduler(const Options& options) : impl(make_unique<SchedulerState>()) {
+    impl->options = options;
+    impl->options.threads = max(options.threads, 1);
+    impl->options.stackSize = (options.stackSize + impl->pageSize - 1) / impl->pageSize * impl->pageSize;
+    for (int i = 0; i < impl->options.threads; ++i) {
+        impl->workers.push_back(make_unique<Worker>());
+        Worker& worker = *impl->workers.back();
+        worker.scheduler = impl.get();
+        worker.runner = std::thread([&worker] { worker.loop(); });
+    }
+}
+
+Scheduler::~Scheduler() {
+    wait();
+    for (auto& worker : impl->workers) {
+        {
+            lock_guard<mutex> guard(worker->lock);
+            worker->stopping = true;
+        }
+        worker->wake.notify_one();
+        worker->runner.join();
+        impl->freeStacks(*worker);
+    }
+}
+
+void Scheduler::submit(const Program& program, Bindings bindings, Done done, const Limits& limits) {
+    {
+        lock_guard<mutex> guard(impl->lock);
+        impl->unfinished++;
+    }
+    // the least loaded worker; a run stays with it
+    Worker* worker = impl->workers[0].get();
+    for (auto& w : impl->workers) {
+        if (w->load < worker->load)
+            worker = w.get();
+    }
+    worker->load++;
+    auto task = make_unique<Task>();
+    task->program = program;
+    task->bindings = move(bindings);
+    task->done = move(done);
+    task->limits = limits;
+    task->worker = worker;
+    task->state.meter.quantum = task->state.meter.quantumLeft = impl->options.quantum;
+    // a level of nesting takes up to about 2.5 KB of stack, in debug builds too
+    task->state.meter.maxDepth = (int)min<size_t>(maxNesting, impl->options.stackSize / 4096);
+    {
+        lock_guard<mutex> guard(worker->lock);
+        worker->submitted.push_back(move(task));
+    }
+    worker->wake.notify_one();
+}
+
+void Scheduler::wait() {
+    unique_lock<mutex> guard(impl->lock);
+    impl->idle.wait(guard, [&] { return impl->unfinished == 0; });
+}
+
+} // namespace cinterp
+// --------------------------------------- ^^^ SCHEDULER ^^^ ---------------------------------------
+
+
+// ------------------------------------- INCREMENTAL EDITING -------------------------------------
+// cinterp::Document. The source is held as units (the program header, each
+// declaration, each top-level statement, and the closing "} ." with whatever
+// follows it), each with its tokens and the first error in it. An edit
+// re-lexes from the start of the unit before the one it touches, going
+// further back until that start follows a blank (no scanner rule looks past a
+// blank, so the tokens before it cannot change). A syntax-only recognizer then
+// re-parses unit by unit. It stops at the first unit boundary past the edit
+// that falls on the start of an old unit, with the scanner at the same column
+// and the parser expecting the same thing. From there on the scanner and
+// parser would repeat exactly what they did before, so the old units are kept.
+// Token lines are relative to their unit, so an edit that adds or removes
+// lines only moves the starts of the units after it.
+//
+// The recognizer follows the rules above as they run when every statement is
+// executed, with the same messages, but checks no types or names.
+
+namespace cinterp {
+
+enum class Expect : uint8_t { header, firstDeclaration, declaration, statement, end };
+
+// where a unit starts: byte offset (0 for the first unit, else its first
+// token), and the scanner's line and column there
+struct UnitStart {
+    size_t offset;
+    int line;
+    int column;
+};
+
+struct Unit {
+    int column;             // the scanner's column at its start
+    Expect expect;          // what the parser expected there
+    vector<Token> tokens;   // lines relative to the unit's line
+
+    // the first error the parser reaches, at failToken: a lexical error, or a
+    // syntax error whose message follows "found '...'. "
+    int failToken = -1;
+    bool failLexical = false;
+    string syntaxMessage;
+
+    // the first token with a lexical error, where a run stops reading
+    int lexicalToken = -1;
+    bool lexicalRange = false;              // a literal out of range
+    handscanner::LexicalError lexical;      // a scanner error, line relative to the unit's
+};
+
+// the source lexed from a unit start on demand
+struct UnitLexer {
+    handscanner::HandScanner scanner;
+    const char* base;
+    vector<Token> tokens;       // absolute lines
+    vector<size_t> offsets;     // from base
+    vector<int> columns;
+    vector<uint8_t> bad;        // has a lexical error
+    vector<pair<size_t, handscanner::LexicalError>> errors;    // scanner errors by token
+    bool ended = false;
+
+    UnitLexer(const string& source, const UnitStart& from)
+        : scanner(source.data() + from.offset, source.size() - from.offset), base(source.data()) {
+        scanner.line = from.line;
+        scanner.col = from.column;
+        scanner.deferErrors = true;
+    }
+
+    // token k; past the end of input, the end-of-input token
+    const Token& at(size_t k) {
+        while (tokens.size() <= k && !ended)
+            lexOne();
+        return tokens[min(k, tokens.size() - 1)];
+    }
+    bool isBad(size_t k) {
+        at(k);
+        return bad[min(k, bad.size() - 1)];
+    }
+
+    void lexOne() {
+        int type = scanner.next();
+        ended = type == 0 && scanner.length == 0;
+        tokens.emplace_back((TokenType)type, string(scanner.text, scanner.length), scanner.line);
+        offsets.push_back(scanner.text - base);
+        columns.push_back(scanner.column);
+        Token& token = tokens.back();
+        bool error = false;
+        if (scanner.failed) {
+            errors.push_back({tokens.size() - 1, scanner.error});
+            scanner.failed = false;
+            error = true;
+        } else if (type == NUM) {
+            error = !parseLiteral(token.value, token.number);
+        }
+        bad.push_back(error);
+    }
+};
+
+struct SyntaxFailure {
+    size_t token;
+    bool lexical;
+    string message;
+};
+
+class SyntaxCheck {
+public:
+    explicit SyntaxCheck(UnitLexer& in) : in(in) {}
+
+    size_t pos = 0;
+
+    // parses one unit from pos; the state after it, or throws SyntaxFailure
+    Expect unit(Expect expect) {
+        if (pos == 0 && in.isBad(0))
+            throw SyntaxFailure{0, true, ""};
+        switch (expect) {
+            case Expect::header:
+                match(PROGRAM);
+                match(ID);
+                match(LBRACE);
+                return Expect::firstDeclaration;
+            case Expect::declaration:
+                if (current().type != INT && current().type != FLOAT)
+                    return statementOrEnd();
+                [[fallthrough]];
+            case Expect::firstDeclaration:
+                declaration();
+                return Expect::declaration;
+            default:
+                return statementOrEnd();
+        }
+    }
+
+private:
+    UnitLexer& in;
+
+    const Token& current() { return in.at(pos); }
+
+    void advance() {
+        ++pos;
+        if (in.isBad(pos))
+            throw SyntaxFailure{pos, true, ""};
+    }
+
+    [[noreturn]] void error(const string& message) {
+        throw SyntaxFailure{pos, false, message};
+    }
+
+    void match(TokenType expected) {
+        if (current().type != expected) {
+            error(string("Expected token type ") + tokenTypeNames[expected]
+                  + " but found " + tokenTypeNames[current().type]);
+        }
+        advance();
+    }
+
+    bool atStatement() {
+        TokenType t = current().type;
+        return t == ID || t == LBRACE || t == IF || t == WHILE;
+    }
+
+    Expect statementOrEnd() {
+        if (atStatement()) {
+            statement();
+            return Expect::statement;
+        }
+        match(RBRACE);
+        match(DOT);
+        return Expect::end;
+    }
+
+    void declaration() {
+        if (current().type != INT && current().type != FLOAT)
+            error("Expected 'int' or 'float' keyword");
+        advance();
+        match(ID);
+        if (current().type == SEMICOLON) {
+            match(SEMICOLON);
+        } else if (current().type == LBRACKET) {
+            match(LBRACKET);
+            match(NUM);
+            match(RBRACKET);
+            match(SEMICOLON);
+        } else {
+            error("Expected ';' or '[' after variable declaration");
+        }
+    }
+
+    void statement() {
+        switch (current().type) {
+            case ID:
+                var();
+                match(ASSIGN);
+                expression();
+                break;
+            case LBRACE:
+                match(LBRACE);
+                while (atStatement())
+                    statement();
+                match(RBRACE);
+                break;
+            case IF:
+                match(IF);
+                match(LPAREN);
+                expression();
+                match(RPAREN);
+                statement();
+                if (current().type == ELSE) {
+                    match(ELSE);
+                    statement();
+                }
+                break;
+            case WHILE:
+                match(WHILE);
+                match(LPAREN);
+                expression();
+                match(RPAREN);
+                statement();
+                break;
+            default:
+                error("Expected statement (ID, '{', 'if', or 'while')");
+        }
+    }
+
+    void var() {
+        match(ID);
+        if (current().type == LBRACKET) {
+            match(LBRACKET);
+            expression();
+            match(RBRACKET);
+        }
+    }
+
+    void expression() {
+        additive();
+        for (TokenType t; (t = current().type) == LT || t == LTE || t == GT || t == GTE || t == EQ || t == NEQ;) {
+            advance();
+            additive();
+        }
+    }
+
+    void additive() {
+        term();
+        while (current().type == PLUS || current().type == MINUS) {
+            advance();
+            term();
+        }
+    }
+
+    void term() {
+        factor();
+        while (current().type == MUL || current().type == DIV) {
+            advance();
+            factor();
+        }
+    }
+
+    void factor() {
+        if (current().type == LPAREN) {
+            match(LPAREN);
+            expression();
+            match(RPAREN);
+        } else if (current().type == ID) {
+            var();
+        } else if (current().type == NUM) {
+            match(NUM);
+        } else {
+            error("Expected '(', ID, or NUM");
+        }
+    }
+};
+
+bool sameToken(const Token& a, const Token& b) {
+    return a.type == b.type && a.value == b.value && a.line == b.line;
+}
+
+// a scalar or one array element: slot << 32 | (element + 1)
+using Location = uint64_t;
+
+// what a top-level statement did in a run: the locations it read before
+// writing them, and the last value it wrote to each location, both sorted
+struct StatementRecord {
+    size_t position;    // in run order
+    vector<Location> reads;
+    vector<pair<Location, string>> writes;
+
+    const string& wrote(Location l) const {
+        return lower_bound(writes.begin(), writes.end(), l, [](const auto& w, Location l) {
+            return w.first < l;
+        })->second;
+    }
+};
+
+// the statements that wrote and read a location, in run order
+struct LocationLog {
+    vector<StatementRecord*> writers;
+    vector<StatementRecord*> readers;
+};
+
+// Unit starts, lines and records are kept apart from the units, in flat
+// arrays, so that going over them is cheap even with many units.
+struct DocumentState {
+    string source;
+    vector<size_t> starts;
+    vector<int> lines;
+    vector<unique_ptr<Unit>> units;
+    Document::EditStats stats;
+
+    // the last run that succeeded (INCREMENTAL EXECUTION)
+    vector<Token> ranDeclarations;                  // header and declarations, absolute lines
+    shared_ptr<const CompiledProgram> declarations; // their slots and initial values
+    unordered_map<string, Symbol> table;            // the final values
+    vector<shared_ptr<StatementRecord>> records;    // per unit, for the statements it ran
+    vector<shared_ptr<StatementRecord>> retired;    // of statements edited away since
+    unordered_map<Location, LocationLog> logs;
+    Document::RunStats runStats;
+
+    void run();
+
+    explicit DocumentState(string_view text) : source(text) {
+        reparse(0, SIZE_MAX, 0);
+    }
+
+    void edit(size_t offset, size_t length, string_view text) {
+        if (offset > source.size() || length > source.size() - offset)
+            throw Error(ErrorKind::usage, 0, "edit past the end of the source");
+        size_t first = restartUnit(offset);
+        source.replace(offset, length, text);
+        reparse(first, offset + text.size(), (ptrdiff_t)text.size() - (ptrdiff_t)length);
+    }
+
+    // the unit to re-lex from for an edit at offset
+    size_t restartUnit(size_t offset) const {
+        // the unit holding the byte before the edit, whose last token may grow
+        // into it, and the one before, whose end the parser decides by looking
+        // at the first token of the next
+        size_t holding = 0;
+        if (offset > 0)
+            holding = upper_bound(starts.begin(), starts.end(), offset - 1) - starts.begin() - 1;
+        size_t first = holding > 0 ? holding - 1 : 0;
+        while (first > 0 && !strchr(" \t\n", source[starts[first] - 1]))
+            --first;
+        return first;
+    }
+
+    // re-lexes and re-parses from units[first] in the edited source. Bytes
+    // before newEditEnd are new; after it they are the old bytes moved by delta.
+    void reparse(size_t first, size_t newEditEnd, ptrdiff_t delta) {
+        UnitStart from{0, 1, 1};
+        Expect expect = Expect::header;
+        if (first < units.size()) {
+            from = {starts[first], lines[first], units[first]->column};
+            expect = units[first]->expect;
+        }
+        UnitLexer in(source, from);
+        SyntaxCheck check(in);
+        vector<size_t> freshStarts;
+        vector<int> freshLines;
+        vector<unique_ptr<Unit>> fresh;
+        vector<shared_ptr<StatementRecord>> freshRecords;
+        size_t keep = units.size();     // first old unit kept
+        int lineDelta = 0;
+
+        // an old unit that starts where token k does, in the same state
+        auto resumes = [&](size_t k, bool anyState) {
+            in.at(k);
+            if (k >= in.tokens.size() || in.offsets[k] < newEditEnd)
+                return false;
+            size_t oldStart = in.offsets[k] - delta;
+            size_t j = lower_bound(starts.begin() + first + 1, starts.end(), oldStart) - starts.begin();
+            if (j == units.size() || starts[j] != oldStart || units[j]->column != in.columns[k]
+                || (!anyState && units[j]->expect != expect))
+                return false;
+            keep = j;
+            lineDelta = in.tokens[k].line - lines[j];
+            return true;
+        };
+
+        size_t begin = 0;
+        for (bool done = false; !done;) {
+            UnitStart at = fresh.empty() ? from : UnitStart{in.offsets[begin], in.tokens[begin].line, in.columns[begin]};
+            auto unit = make_unique<Unit>();
+            unit->column = at.column;
+            unit->expect = expect;
+            size_t end;
+            try {
+                expect = check.unit(expect);
+                end = check.pos;
+                if (expect == Expect::end) {
+                    while (!in.ended)
+                        in.lexOne();
+                    end = in.tokens.size();
+                    done = true;
+                } else {
+                    done = resumes(end, false);
+                }
+            } catch (const SyntaxFailure& failure) {
+                in.at(failure.token);
+                unit->failToken = (int)(min(failure.token, in.tokens.size() - 1) - begin);
+                unit->failLexical = failure.lexical;
+                unit->syntaxMessage = failure.message;
+                // nothing after an error means anything until it is fixed:
+                // the unit runs on to the next old unit or the end of input
+                end = failure.token + 1;
+                while (!resumes(end, true) && !(in.ended && end >= in.tokens.size()))
+                    ++end;
+                end = min(end, in.tokens.size());
+                done = true;
+            }
+
+            for (size_t k = begin; k < end; ++k) {
+                Token& token = in.tokens[k];
+                if (in.bad[k] && unit->lexicalToken < 0) {
+                    unit->lexicalToken = (int)(k - begin);
+                    auto error = find_if(in.errors.begin(), in.errors.end(), [&](auto& e) { return e.first == k; });
+                    unit->lexicalRange = error == in.errors.end();
+                    if (!unit->lexicalRange) {
+                        unit->lexical = error->second;
+                        unit->lexical.line -= at.line;
+                    }
+                }
+                token.line -= at.line;
+                unit->tokens.push_back(move(token));
+            }
+            freshStarts.push_back(at.offset);
+            freshLines.push_back(at.line);
+            fresh.push_back(move(unit));
+            begin = check.pos = end;
+        }
+
+        stats.tokensLexed = in.tokens.size();
+        stats.unitsParsed = fresh.size();
+        stats.unitsKept = units.size() - keep;
+
+        // a statement lexed again exactly as it was keeps its record, so the
+        // next run need not execute it
+        freshRecords.resize(fresh.size());
+        for (size_t i = first; i < keep; ++i) {
+            size_t k = i - first;
+            if (!records[i])
+                continue;
+            if (k < fresh.size() && equal(units[i]->tokens.begin(), units[i]->tokens.end(),
+                                          fresh[k]->tokens.begin(), fresh[k]->tokens.end(), sameToken))
+                freshRecords[k] = move(records[i]);
+            else
+                retired.push_back(move(records[i]));
+        }
+        for (size_t i = keep; i < units.size(); ++i) {
+            starts[i] += delta;
+            lines[i] += lineDelta;
+        }
+        splice(starts, first, keep, freshStarts);
+        splice(lines, first, keep, freshLines);
+        splice(units, first, keep, fresh);
+        splice(records, first, keep, freshRecords);
+    }
+
+    // replaces v[first, keep) with fresh
+    template <typename T>
+    static void splice(vector<T>& v, size_t first, size_t keep, vector<T>& fresh) {
+        size_t common = min(keep - first, fresh.size());
+        move(fresh.begin(), fresh.begin() + common, v.begin() + first);
+        if (common < fresh.size())
+            v.insert(v.begin() + keep, make_move_iterator(fresh.begin() + common), make_move_iterator(fresh.end()));
+        else
+            v.erase(v.begin() + first + common, v.begin() + keep);
+    }
+
+    optional<Error> check() const {
+        for (size_t i = 0; i < units.size(); ++i) {
+            const Unit& unit = *units[i];
+            if (unit.failToken < 0)
+                continue;
+            if (unit.failLexical) {
+                auto [message, line] = lexicalError(unit, lines[i]);
+                return Error(ErrorKind::lexical, line, message);
+            }
+            const Token& token = unit.tokens[unit.failToken];
+            int line = lines[i] + token.line;
+            return Error(ErrorKind::syntax, line, "Syntax error at line " + to_string(line) + ": found '"
+                         + token.value + "'. " + unit.syntaxMessage);
+        }
+        return nullopt;
+    }
+
+    static pair<string, int> lexicalError(const Unit& unit, int unitLine) {
+        const Token& token = unit.tokens[unit.lexicalToken];
+        if (unit.lexicalRange)
+            return {literalRangeError(token.value, unitLine + token.line), unitLine + token.line};
+        return {unit.lexical.message(unitLine), unitLine + unit.lexical.line};
+    }
+
+    // runs the whole token stream from scratch, as the command-line
+    // interpreter would; the final table
+    unordered_map<string, Symbol> runAll() const {
+        string error;
+        int errorLine = 0;
+        vector<Token> all = tokens(error, errorLine);
+        EmbeddedState state(&all, 0);
+        struct StreamError {
+            ~StreamError() { tokenStreamError.clear(); }
+        } streamError;
+        tokenStreamError = error;
+        tokenStreamErrorLine = errorLine;
+        currentToken = getToken();
+        program();
+        return move(symbolTable);
+    }
+
+    // the whole token stream, as the scanner would deliver it: up to the first
+    // lexical error, which then ends it (tokenStreamError)
+    vector<Token> tokens(string& error, int& errorLine) const {
+        vector<Token> all;
+        error.clear();
+        for (size_t i = 0; i < units.size(); ++i) {
+            const Unit& unit = *units[i];
+            size_t n = unit.lexicalToken < 0 ? unit.tokens.size() : unit.lexicalToken;
+            for (size_t k = 0; k < n; ++k) {
+                all.push_back(unit.tokens[k]);
+                all.back().line += lines[i];
+            }
+            if (unit.lexicalToken >= 0) {
+                tie(error, errorLine) = lexicalError(unit, lines[i]);
+                all.emplace_back(UNKNOWN, "", errorLine);
+                break;
+            }
+        }
+        return all;
+    }
+};
+
+Document::Document(string_view source) : impl(make_unique<DocumentState>(source)) {}
+Document::~Document() = default;
+Document::Document(Document&&) noexcept = default;
+Document& Document::operator=(Document&&) noexcept = default;
+
+void Document::edit(size_t offset, size_t length, string_view text) {
+    impl->edit(offset, length, text);
+}
+
+const string& Document::source() const {
+    return impl->source;
+}
+
+optional<Error> Document::check() const {
+    return impl->check();
+}
+
+Program Document::compile() const {
+    string error;
+    int line = 0;
+    vector<Token> tokens = impl->tokens(error, line);
+    if (!error.empty())
+        throw Error(ErrorKind::lexical, line, error);
+    Program program;
+    program.impl = compileTokens(move(tokens));
+    return program;
+}
+
+Document::EditStats Document::lastEdit() const {
+    return impl->stats;
+}
+
+} // namespace cinterp
+// ---------------------------------- ^^^ INCREMENTAL EDITING ^^^ ----------------------------------
+
+
+// ------------------------------------ INCREMENTAL EXECUTION ------------------------------------
+// Document::run. A run records what each top-level statement did: the
+// locations it read before writing them, and the last value it wrote to each
+// location it wrote. For each location it keeps the statements that wrote and
+// read it, in run order. So the value any statement saw can be looked up, and
+// a statement that would see the same values again would do the same again.
+//
+// The next run lays out the kept statements, the new ones and the removed
+// ones on one timeline, and goes through it in order. New statements are
+// executed. A removed statement counts as one that now writes nothing. A
+// location whose value after a step differs from the last run's is dirty
+// until its next recorded writer, and the kept statements that read it in
+// that stretch are executed again. The rest keep their records and are not
+// looked at. A statement that runs again can make more locations dirty, or
+// clean again. The statements that run are executed in order, so the first
+// error is the one a full run would stop at.
+//
+// A change to the header or the declarations starts over with a full run. So
+// does any lexical or syntax error, which the full run then reports.
+
+namespace cinterp {
+
+// one top-level statement on the timeline
+struct Step {
+    StatementRecord* old;   // its record from the last run; null if new
+    size_t unit;            // SIZE_MAX if removed
+};
+
+class Replay : public StatementObserver {
+public:
+    Replay(DocumentState& doc, vector<Step> steps)
+        : doc(doc), declared(*doc.declarations), steps(move(steps)),
+          results(this->steps.size()), queued(this->steps.size()) {
+        symbolTable.swap(doc.table);
+        statementObserver = this;
+    }
+    ~Replay() {
+        statementObserver = nullptr;
+        symbolTable.swap(doc.table);
+    }
+
+    size_t executed = 0;
+
+    void run() {
+        for (size_t p = 0; p < steps.size(); ++p) {
+            if (!steps[p].old || steps[p].unit == SIZE_MAX)
+                enqueue(p);
+        }
+        try {
+            while (!pending.empty()) {
+                size_t p = pending.top();
+                pending.pop();
+                visit(p);
+            }
+        } catch (...) {
+            // back to the last run's final values
+            for (Location l : affected)
+                valueOf(l) = finalValue(l);
+            throw;
+        }
+    }
+
+    // replaces the records of the statements visited, then numbers all of
+    // them in the new order
+    void commit() {
+        for (size_t p : visited) {
+            if (steps[p].old)
+                unlog(*steps[p].old);
+            if (results[p])
+                log(*results[p]);
+        }
+        size_t position = 0;
+        for (size_t p = 0; p < steps.size(); ++p) {
+            if (steps[p].unit == SIZE_MAX)
+                continue;
+            auto& record = doc.records[steps[p].unit];
+            if (results[p])
+                record = results[p];
+            record->position = position++;
+        }
+        doc.retired.clear();
+        for (Location l : affected)
+            valueOf(l) = finalValue(l);
+    }
+
+private:
+    struct Dirty {
+        string value;
+        size_t since;   // the step after which it holds
+    };
+
+    EmbeddedState state{nullptr, 0};
+    DocumentState& doc;
+    const CompiledProgram& declared;
+    vector<Step> steps;
+    vector<shared_ptr<StatementRecord>> results;    // of the statements executed
+    vector<uint8_t> queued;
+    priority_queue<size_t, vector<size_t>, greater<size_t>> pending;
+    vector<size_t> visited;
+    unordered_map<Location, Dirty> dirty;
+    vector<Location> affected;      // values that may differ from the final ones
+    vector<Token> tokens;
+
+    // the statement executing
+    size_t now = 0;
+    unordered_set<Location> seen;   // loaded or written by it
+    unordered_set<Location> written;
+    vector<Location> reads;
+
+    static bool before(const StatementRecord* r, size_t p) {
+        return r->position < p;
+    }
+
+    Location locate(const string& name, int index) const {
+        return (Location)declared.slotOf.at(name) << 32 | (uint32_t)(index + 1);
+    }
+
+    string& valueOf(Location l) {
+        Symbol& sym = symbolTable.at(declared.slots[l >> 32].name);
+        int index = (int)(uint32_t)l - 1;
+        return index < 0 ? sym.value : sym.values[index];
+    }
+
+    const string& initial(Location l) const {
+        const Symbol& sym = declared.declared[l >> 32];
+        int index = (int)(uint32_t)l - 1;
+        return index < 0 ? sym.value : sym.values[index];
+    }
+
+    const string& finalValue(Location l) const {
+        auto log = doc.logs.find(l);
+        if (log == doc.logs.end() || log->second.writers.empty())
+            return initial(l);
+        return log->second.writers.back()->wrote(l);
+    }
+
+    // the last run's value of l just before step p
+    const string& recordedBefore(Location l, size_t p) const {
+        auto log = doc.logs.find(l);
+        if (log != doc.logs.end()) {
+            const auto& writers = log->second.writers;
+            auto w = lower_bound(writers.begin(), writers.end(), p, before);
+            if (w != writers.begin())
+                return (*prev(w))->wrote(l);
+        }
+        return initial(l);
+    }
+
+    // the step of the first recorded writer of l after step p
+    size_t nextWriter(Location l, size_t p) const {
+        auto log = doc.logs.find(l);
+        if (log == doc.logs.end())
+            return SIZE_MAX;
+        const auto& writers = log->second.writers;
+        auto w = lower_bound(writers.begin(), writers.end(), p + 1, before);
+        return w == writers.end() ? SIZE_MAX : (*w)->position;
+    }
+
+    const Dirty* dirtyAt(Location l, size_t p) const {
+        auto d = dirty.find(l);
+        if (d == dirty.end() || d->second.since >= p || nextWriter(l, d->second.since) < p)
+            return nullptr;
+        return &d->second;
+    }
+
+    // this run's value of l just before step p
+    const string& valueBefore(Location l, size_t p) const {
+        const Dirty* d = dirtyAt(l, p);
+        return d ? d->value : recordedBefore(l, p);
+    }
+
+    void enqueue(size_t p) {
+        if (!queued[p]) {
+            queued[p] = 1;
+            pending.push(p);
+        }
+    }
+
+    // l holds value after step p
+    void settle(Location l, size_t p, string value) {
+        affected.push_back(l);
+        if (value == recordedBefore(l, p + 1)) {
+            dirty.erase(l);
+            return;
+        }
+        auto log = doc.logs.find(l);
+        if (log != doc.logs.end()) {
+            size_t until = nextWriter(l, p);
+            const auto& readers = log->second.readers;
+            for (auto r = lower_bound(readers.begin(), readers.end(), p + 1, before);
+                 r != readers.end() && (*r)->position <= until; ++r)
+                enqueue((*r)->position);
+        }
+        dirty[l] = {move(value), p};
+    }
+
+    void visit(size_t p) {
+        const Step& step = steps[p];
+        bool removed = step.unit == SIZE_MAX;
+        if (step.old && !removed
+            && none_of(step.old->reads.begin(), step.old->reads.end(), [&](Location l) { return dirtyAt(l, p); }))
+            return;
+        visited.push_back(p);
+        if (!removed) {
+            results[p] = execute(p, step.unit);
+            ++executed;
+            for (const auto& [l, value] : results[p]->writes)
+                settle(l, p, value);
+        }
+        if (step.old) {
+            for (const auto& [l, value] : step.old->writes) {
+                if (removed || !binary_search(results[p]->writes.begin(), results[p]->writes.end(),
+                                              pair<Location, string>(l, ""),
+                                              [](const auto& a, const auto& b) { return a.first < b.first; }))
+                    settle(l, p, valueBefore(l, p));
+            }
+        }
+    }
+
+    shared_ptr<StatementRecord> execute(size_t p, size_t u) {
+        const Unit& unit = *doc.units[u];
+        int line = doc.lines[u];
+        tokens = unit.tokens;
+        for (Token& token : tokens)
+            token.line += line;
+        // the statement ends where the next unit starts, so an error found
+        // at the lookahead reports that token's line, as in a full run
+        tokens.push_back(doc.units[u + 1]->tokens.front());
+        tokens.back().line += doc.lines[u + 1];
+
+        now = p;
+        seen.clear();
+        written.clear();
+        reads.clear();
+        tokenStream = &tokens;
+        tokenPosition = 0;
+        executeIf = true;
+        currentToken = getToken();
+        statement();
+
+        auto record = make_shared<StatementRecord>();
+        record->position = p;
+        sort(reads.begin(), reads.end());
+        reads.erase(unique(reads.begin(), reads.end()), reads.end());
+        record->reads = reads;
+        vector<Location> writes(written.begin(), written.end());
+        sort(writes.begin(), writes.end());
+        for (Location l : writes)
+            record->writes.emplace_back(l, valueOf(l));
+        return record;
+    }
+
+    void log(StatementRecord& record) {
+        auto insert = [&](vector<StatementRecord*>& list) {
+            list.insert(lower_bound(list.begin(), list.end(), record.position, before), &record);
+        };
+        for (Location l : record.reads)
+            insert(doc.logs[l].readers);
+        for (const auto& write : record.writes)
+            insert(doc.logs[write.first].writers);
+    }
+
+    void unlog(StatementRecord& record) {
+        auto erase = [&](Location l, bool writer) {
+            auto log = doc.logs.find(l);
+            auto& list = writer ? log->second.writers : log->second.readers;
+            list.erase(lower_bound(list.begin(), list.end(), record.position, before));
+            if (log->second.writers.empty() && log->second.readers.empty())
+                doc.logs.erase(log);
+        };
+        for (Location l : record.reads)
+            erase(l, false);
+        for (const auto& write : record.writes)
+            erase(write.first, true);
+    }
+
+    // StatementObserver
+    void load(const string& name, int index) override {
+        Location l = locate(name, index);
+        if (!seen.insert(l).second)
+            return;
+        affected.push_back(l);
+        valueOf(l) = valueBefore(l, now);
+    }
+
+    void read(const Symbol& sym) override {
+        Location l = locate(sym.name, sym.lastIndex);
+        if (!written.count(l))
+            reads.push_back(l);
+    }
+
+    void write(const Symbol& sym) override {
+        Location l = locate(sym.name, sym.lastIndex);
+        seen.insert(l);
+        written.insert(l);
+        affected.push_back(l);
+    }
+};
+
+void DocumentState::run() {
+    if (optional<Error> error = check()) {
+        runAll();   // throws the error the run reaches first
+        throw *error;
+    }
+
+    // units: the header, the declarations, the statements, then "} ."
+    size_t first = 1;
+    while (first + 1 < units.size() && (units[first]->tokens[0].type == INT || units[first]->tokens[0].type == FLOAT))
+        ++first;
+    size_t end = units.size() - 1;
+
+    vector<Token> head;
+    for (size_t i = 0; i < first; ++i) {
+        for (const Token& token : units[i]->tokens) {
+            head.push_back(token);
+            head.back().line += lines[i];
+        }
+    }
+    bool reset = !declarations || head.size() != ranDeclarations.size()
+                 || !equal(head.begin(), head.end(), ranDeclarations.begin(), sameToken);
+    if (reset) {
+        // until a full run succeeds, the next run is full too
+        declarations.reset();
+        ranDeclarations.clear();
+        retired.clear();
+        logs.clear();
+        table = unordered_map<string, Symbol>();    // iterates like the interpreter's own table
+        head.emplace_back(PROGRAM, "", head.back().line);
+        declarations = compileTokens(head);
+        head.pop_back();
+        for (const Symbol& sym : declarations->declared)
+            table.emplace(sym.name, sym);
+    }
+
+    // the timeline: kept statements in their order, each removed one just
+    // before the first kept one that followed it, and each position moved
+    // to the step's
+    vector<Step> steps;
+    sort(retired.begin(), retired.end(), [](const auto& a, const auto& b) { return a->position < b->position; });
+    size_t next = 0;
+    auto removedBefore = [&](size_t position) {
+        for (; next < retired.size() && retired[next]->position < position; ++next) {
+            retired[next]->position = steps.size();
+            steps.push_back({retired[next].get(), SIZE_MAX});
+        }
+    };
+    for (size_t u = first; u < end; ++u) {
+        StatementRecord* old = reset ? nullptr : records[u].get();
+        if (old) {
+            removedBefore(old->position);
+            old->position = steps.size();
+        }
+        steps.push_back({old, u});
+    }
+    removedBefore(SIZE_MAX);
+
+    Replay replay(*this, move(steps));
+    replay.run();
+    replay.commit();
+    ranDeclarations = move(head);
+    runStats.statementsRun = replay.executed;
+    runStats.statementsReused = end - first - replay.executed;
+}
+
+Instance Document::run() {
+    impl->run();
+    Instance instance;
+    instance.compiled.impl = impl->declarations;
+    symbolTable.swap(impl->table);
+    instance.capture();
+    symbolTable.swap(impl->table);
+    return instance;
+}
+
+Document::RunStats Document::lastRun() const {
+    return impl->runStats;
+}
+
+} // namespace cinterp
+// --------------------------------- ^^^ INCREMENTAL EXECUTION ^^^ ---------------------------------
+
+#ifndef CINTERP_NO_MAIN
+// --incremental=FILE: keeps FILE as a cinterp::Document and reads commands
+// from stdin, one per line, for an editor that would otherwise re-run the
+// interpreter on every keystroke. Every reply ends with "=== Done ===".
+//   edit OFFSET LENGTH SIZE  replace LENGTH bytes at OFFSET with the SIZE
+//                            bytes that follow the line; replies with what
+//                            was re-lexed and re-parsed
+//   check                    "ok", or the first lexical or syntax error
+//   run                      what running the current source prints; after
+//                            the first run, only what the edits affect runs
+//   stats                    how many statements the last run executed
+//   tokens                   what --dump-tokens prints for it
+//   source                   the current source
+//   verify                   "ok" if re-reading the whole source gives the same
+//                            tokens and check result, and running it in full
+//                            the same result as a run after the last one, else
+//                            "mismatch"
+int editSession(const string& path) {
+    FILE* in = fopen(path.c_str(), "rb");
+    if (!in) {
+        cerr << "Error: cannot read '" << path << "'" << endl;
+        return 1;
+    }
+    cinterp::DocumentState document(readAll(in));
+    fclose(in);
+    double runMicros = 0;
+
+    // a run's outcome, to compare: its error, or the final values by name
+    auto outcome = [](auto run) {
+        string result;
+        try {
+            map<string, Symbol> sorted;
+            for (auto& [name, sym] : run())
+                sorted.emplace(name, sym);
+            for (auto& [name, sym] : sorted) {
+                result += name + " = " + sym.value;
+                for (const string& v : sym.values)
+                    result += " " + v;
+                result += "\n";
+            }
+        } catch (const cinterp::Error& e) {
+            result = "error at line " + to_string(e.line) + ": " + e.what();
+        }
+        return result;
+    };
+
+    string command;
+    while (cin >> command) {
+        if (command == "edit") {
+            size_t offset, length, size;
+            cin >> offset >> length >> size;
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            string text(size, '\0');
+            cin.read(text.data(), size);
+            if (!cin) {
+                cerr << "Error: edit text ends early" << endl;
+                return 1;
+            }
+            long long start = nowNanos();
+            try {
+                document.edit(offset, length, text);
+                const auto& stats = document.stats;
+                printf("%zu tokens lexed, %zu units parsed, %zu kept, %.1f us\n", stats.tokensLexed,
+                       stats.unitsParsed, stats.unitsKept, (nowNanos() - start) / 1e3);
+            } catch (const cinterp::Error& e) {
+                printf("%s\n", e.what());
+            }
+        } else if (command == "check") {
+            optional<cinterp::Error> error = document.check();
+            printf("%s\n", error ? error->what() : "ok");
+        } else if (command == "tokens") {
+            string error;
+            int errorLine = 0;
+            vector<Token> tokens = document.tokens(error, errorLine);
+            for (size_t k = 0; k + !error.empty() < tokens.size(); ++k) {
+                const Token& token = tokens[k];
+                if (token.type == PROGRAM && token.value.empty())
+                    break;
+                printf("%d\t%s\t%s\n", token.line, tokenTypeNames[token.type], token.value.c_str());
+            }
+            fflush(stdout);
+            if (!error.empty())
+                cerr << error << endl;
+        } else if (command == "run") {
+            if (textOutput())
+                cout << "=== Running Parser + Interpreter ===\n";
+            try {
+                long long start = nowNanos();
+                document.run();
+                runMicros = (nowNanos() - start) / 1e3;
+                if (textOutput())
+                    cout << "Parsing completed successfully!" << endl;
+                symbolTable.swap(document.table);
+                printFinalTable();
+                symbolTable.swap(document.table);
+            } catch (const cinterp::Error& e) {
+                cout.flush();
+                cerr << e.what() << endl;
+            }
+            cout.flush();
+        } else if (command == "stats") {
+            const auto& stats = document.runStats;
+            printf("%zu statements run, %zu reused, %.1f us\n", stats.statementsRun, stats.statementsReused, runMicros);
+        } else if (command == "source") {
+            fwrite(document.source.data(), 1, document.source.size(), stdout);
+            printf("\n");
+        } else if (command == "verify") {
+            cinterp::DocumentState fresh(document.source);
+            string error, freshError;
+            int line, freshLine;
+            vector<Token> tokens = document.tokens(error, line), freshTokens = fresh.tokens(freshError, freshLine);
+            optional<cinterp::Error> check = document.check(), freshCheck = fresh.check();
+            bool same = error == freshError && tokens.size() == freshTokens.size()
+                        && equal(tokens.begin(), tokens.end(), freshTokens.begin(), cinterp::sameToken)
+                        && (bool)check == (bool)freshCheck
+                        && (!check || (string(check->what()) == freshCheck->what() && check->line == freshCheck->line))
+                        && outcome([&] { document.run(); return document.table; }) == outcome([&] { return document.runAll(); });
+            printf("%s\n", same ? "ok" : "mismatch");
+        } else {
+            printf("unknown command '%s'\n", command.c_str());
+        }
+        printf("=== Done ===\n");
+        fflush(stdout);
+    }
+    return 0;
+}
+
+// --repl: reads declarations and statements from stdin and runs each entry as
+// soon as it is complete, against one symbol table kept for the whole session.
+// An entry is a line, or several while a brace or a comment is left open. Only
+// the entry is lexed, by the hand-written scanner, and parsed from its tokens
+// in memory, so nothing entered before is read again. Lines are numbered from
+// the first line of the session.
+//   int n;  float a[10];     declarations, like in a program
+//   n = 3  a[n] = 1.5        statements
+//   a   or   a[n] * 2        prints a variable as the final table lists it,
+//                            or the value of an expression
+//   :vars                    prints the table like at the end of a run
+//   :stats                   how many entries ran and how long they took
+//   :reset                   forgets every variable
+//   :quit                    ends the session, like the end of input
+// --max-steps and --timeout-ms apply to each entry on its own.
+// An error is printed and the session goes on. An entry with a lexical error
+// is not run at all; if one fails later, the declarations it made are undone,
+// but the statements before the error keep their effect.
+int replSession(const cinterp::Limits& limits) {
+    throwErrors = true;
+    executeIf = true;
+    bool interactive = isatty(0);
+    string entry;
+    int entryLine = 1;  // of the entry's first line
+    int line = 1;       // of the next line read
+    long long entries = 0, totalNanos = 0, maxNanos = 0;
+    vector<Token> tokens;
+
+    auto fail = [](const string& message) {
+        fflush(stdout);
+        cerr << message << endl;
+    };
+    auto atEnd = [] { return currentToken.type == PROGRAM && currentToken.value.empty(); };
+
+    auto run = [&] {
+        tokenStream = &tokens;
+        tokenPosition = 0;
+        currentToken = getToken();
+        size_t declared = declarationOrder.size();
+        setLimits(limits.maxSteps, limits.timeoutMs);
+        try {
+            bool assigns = any_of(tokens.begin(), tokens.end(), [](const Token& t) { return t.type == ASSIGN; });
+            if (currentToken.type == ID && tokens.size() == 2) {
+                OutputBuffer out;
+                writeText(out, LiveEntry(getVariable(currentToken.value, currentToken.line)));
+            } else if (!assigns && (currentToken.type == ID || currentToken.type == NUM || currentToken.type == LPAREN)) {
+                Symbol value = expression();
+                if (!atEnd())
+                    error("Expected end of entry");
+                printf("%s  (type: %s)\n", value.value.c_str(), value.type == typeInt ? "int" : "float");
+            } else {
+                while (currentToken.type == INT || currentToken.type == FLOAT)
+                    declaration();
+                statement_list();
+                if (!atEnd())
+                    error("Expected end of entry");
+            }
+        } catch (const cinterp::Error& e) {
+            for (size_t i = declared; i < declarationOrder.size(); ++i)
+                symbolTable.erase(declarationOrder[i]);
+            declarationOrder.resize(declared);
+            executeIf = true;
+            statementDepth = 0;
+            fail(e.what());
+        }
+        setLimits(0, 0);
+        tokenStream = nullptr;
+        fflush(stdout);
+    };
+
+    // runs the entry once it is complete, or at the end of input regardless
+    auto submit = [&](bool last) {
+        long long start = nowNanos();
+        handscanner::Chunk chunk{entry.data(), entry.data() + entry.size(), {}, {}};
+        handscanner::scanComments(chunk);
+        if (chunk.endsInComment[0] && !last)
+            return;
+
+        tokens.clear();
+        handscanner::HandScanner scanner(entry.data(), entry.size());
+        scanner.line = entryLine;
+        scanner.deferErrors = true;
+        string lexicalError;
+        int depth = 0;
+        for (;;) {
+            int type = scanner.next();
+            if (scanner.failed) {
+                lexicalError = scanner.error.message();
+                break;
+            }
+            if (type == 0 && scanner.length == 0)
+                break;
+            tokens.emplace_back((TokenType)type, string(scanner.text, scanner.length), scanner.line);
+            Token& token = tokens.back();
+            if (type == NUM && !parseLiteral(token.value, token.number)) {
+                lexicalError = literalRangeError(token.value, token.line);
+                break;
+            }
+            depth += (type == LBRACE) - (type == RBRACE);
+        }
+        if (lexicalError.empty() && depth > 0 && !last)
+            return;
+
+        entry.clear();
+        if (!lexicalError.empty()) {
+            fail(lexicalError);
+            return;
+        }
+        if (tokens.empty())
+            return;
+        tokens.emplace_back(PROGRAM, "", scanner.line);     // the end of input
+        run();
+        long long nanos = nowNanos() - start;
+        entries++;
+        totalNanos += nanos;
+        maxNanos = max(maxNanos, nanos);
+    };
+
+    string text;
+    for (;;) {
+        if (interactive) {
+            printf(entry.empty() ? "> " : "... ");
+            fflush(stdout);
+        }
+        if (!getline(cin, text))
+            break;
+        if (entry.empty()) {
+            entryLine = line;
+            size_t first = text.find_first_not_of(" \t\r");
+            if (first != string::npos && text[first] == ':') {
+                line++;
+                string command = text.substr(first, text.find_last_not_of(" \t\r") + 1 - first);
+                if (command == ":quit") {
+                    return 0;
+                } else if (command == ":vars") {
+                    printFinalTable();
+                } else if (command == ":stats") {
+                    printf("%lld entries, %.1f us per entry on average, %.1f us at most\n", entries,
+                           entries ? totalNanos / 1e3 / entries : 0.0, maxNanos / 1e3);
+                } else if (command == ":reset") {
+                    symbolTable.clear();
+                    declarationOrder.clear();
+                } else {
+                    fail("unknown command '" + command + "'");
+                }
+                fflush(stdout);
+                continue;
+            }
+        }
+        line++;
+        entry += text;
+        entry += '\n';
+        submit(false);
+    }
+    if (!entry.empty())
+        submit(true);
+    return 0;
+}
+
+// Batch metrics, for operating a long --batch: the latency of each phase per
+// program, and counters of programs, errors by kind and bytes lexed. Every
+// thread that works on programs records into a shard of its own with plain
+// stores to relaxed atomics, so recording takes no lock and no
+// read-modify-write; a reader sums the shards. SIGUSR1 prints the metrics to
+// stderr, --metrics-file=PATH is rewritten every --metrics-every=MS in the
+// Prometheus text format, and --stats prints them at the end. Parse time
+// covers the program header and declarations; statements are parsed as they
+// run, so theirs is part of execute.
+
+// HDR-style: exact below 2^subBits ns, then 2^subBits buckets per power of
+// two, so a quantile is within 1/2^subBits (3%) of the value it stands for
+struct LatencyHistogram {
+    static const int subBits = 5;
+    static const int buckets = (64 - subBits + 1) << subBits;
+
+    atomic<uint64_t> counts[buckets] = {};
+    atomic<uint64_t> sum{0};
+    atomic<uint64_t> largest{0};
+
+    static int bucketOf(uint64_t nanos) {
+        if (nanos < (1u << subBits))
+            return (int)nanos;
+        int exponent = 63 - __builtin_clzll(nanos);
+        return ((exponent - subBits + 1) << subBits) | (int)((nanos >> (exponent - subBits)) & ((1 << subBits) - 1));
+    }
+
+    // the largest value that falls in bucket b
+    static uint64_t bucketTop(int b) {
+        if (b < (1 << subBits))
+            return b;
+        int shift = (b >> subBits) - 1;
+        uint64_t low = (uint64_t)((1 << subBits) | (b & ((1 << subBits) - 1))) << shift;
+        return low + (1ull << shift) - 1;
+    }
+
+    // from the shard's own thread only
+    void record(uint64_t nanos) {
+        atomic<uint64_t>& count = counts[bucketOf(nanos)];
+        count.store(count.load(memory_order_relaxed) + 1, memory_order_relaxed);
+        sum.store(sum.load(memory_order_relaxed) + nanos, memory_order_relaxed);
+        if (nanos > largest.load(memory_order_relaxed))
+            largest.store(nanos, memory_order_relaxed);
+    }
+};
+
+struct LatencySummary {
+    vector<uint64_t> counts = vector<uint64_t>(LatencyHistogram::buckets);
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t largest = 0;
+
+    void add(const LatencyHistogram& h) {
+        for (int b = 0; b < LatencyHistogram::buckets; ++b) {
+            uint64_t n = h.counts[b].load(memory_order_relaxed);
+            counts[b] += n;
+            count += n;
+        }
+        sum += h.sum.load(memory_order_relaxed);
+        largest = max(largest, h.largest.load(memory_order_relaxed));
+    }
+
+    uint64_t quantile(double q) const {
+        uint64_t rank = max<uint64_t>(1, (uint64_t)ceil(q * count));
+        uint64_t seen = 0;
+        for (int b = 0; b < LatencyHistogram::buckets; ++b) {
+            seen += counts[b];
+            if (seen >= rank)
+                return min(LatencyHistogram::bucketTop(b), largest);
+        }
+        return largest;
+    }
+};
+
+// indexed by cinterp::ErrorKind, then a path that could not be read
+const int readError = (int)cinterp::ErrorKind::limit + 1;
+const char* errorKindNames[] = { "lexical", "syntax", "semantic", "usage", "limit", "read" };
+const Phase metricPhases[] = { phaseLex, phaseParse, phaseExecute };
+
+struct MetricsShard {
+    LatencyHistogram phases[3];     // as metricPhases
+    atomic<uint64_t> programs{0};
+    atomic<uint64_t> bytesLexed{0};
+    atomic<uint64_t> errors[readError + 1] = {};
+
+    void recordPhase(Phase phase, long long since) {
+        phases[phase == phaseLex ? 0 : phase == phaseParse ? 1 : 2].record(max(0LL, nowNanos() - since));
+    }
+    static void count(atomic<uint64_t>& counter, uint64_t n = 1) {
+        counter.store(counter.load(memory_order_relaxed) + n, memory_order_relaxed);
+    }
+};
+
+mutex metricsLock;                  // guards the list of shards, not what is in them
+deque<MetricsShard> metricsShards;  // a deque, so a shard never moves
+thread_local MetricsShard* metrics = nullptr;
+
+MetricsShard* newMetricsShard() {
+    lock_guard<mutex> lock(metricsLock);
+    return &metricsShards.emplace_back();
+}
+
+// the end of a phase of one program in a batch: into the thread's metrics
+// and, with --trace, onto its track
+void endPhase(Phase phase, long long since) {
+    if (metrics)
+        metrics->recordPhase(phase, since);
+    if (!tracePath.empty())
+        traceSpan(phaseNames[phase], "batch", since);
+}
+
+struct MetricsSnapshot {
+    LatencySummary phases[3];
+    uint64_t programs = 0;
+    uint64_t bytesLexed = 0;
+    uint64_t errors[readError + 1] = {};
+    long long peakBytes = 0;
+};
+
+MetricsSnapshot readMetrics() {
+    MetricsSnapshot s;
+    {
+        lock_guard<mutex> lock(metricsLock);
+        for (const MetricsShard& shard : metricsShards) {
+            for (int p = 0; p < 3; ++p)
+                s.phases[p].add(shard.phases[p]);
+            s.programs += shard.programs.load(memory_order_relaxed);
+            s.bytesLexed += shard.bytesLexed.load(memory_order_relaxed);
+            for (int k = 0; k <= readError; ++k)
+                s.errors[k] += shard.errors[k].load(memory_order_relaxed);
+        }
+    }
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        s.peakBytes = usage.ru_maxrss * 1024LL;    // kilobytes on Linux
+    return s;
+}
+
+const double metricQuantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+void printMetrics(FILE* out, const MetricsSnapshot& s) {
+    fprintf(out, "=== Metrics ===\n%-8s %9s %9s %9s %9s %9s %9s   (us)\n", "phase", "count", "p50", "p90", "p99",
+            "p999", "max");
+    for (int p = 0; p < 3; ++p) {
+        const LatencySummary& h = s.phases[p];
+        fprintf(out, "%-8s %9llu", phaseNames[metricPhases[p]], (unsigned long long)h.count);
+        for (double q : metricQuantiles)
+            fprintf(out, " %9.1f", h.quantile(q) / 1e3);
+        fprintf(out, " %9.1f\n", h.largest / 1e3);
+    }
+    fprintf(out, "programs %llu, bytes lexed %llu, peak memory %.1f MB\nerrors:",
+            (unsigned long long)s.programs, (unsigned long long)s.bytesLexed, s.peakBytes / 1048576.0);
+    for (int k = 0; k <= readError; ++k) {
+        if (k != (int)cinterp::ErrorKind::usage)
+            fprintf(out, " %s %llu", errorKindNames[k], (unsigned long long)s.errors[k]);
+    }
+    fprintf(out, "\n");
+}
+
+string prometheusMetrics(const MetricsSnapshot& s) {
+    string text;
+    char line[256];
+    auto add = [&](const char* format, auto... args) {
+        snprintf(line, sizeof(line), format, args...);
+        text += line;
+    };
+    text += "# HELP cinterp_phase_seconds Time a program spent in each phase.\n"
+            "# TYPE cinterp_phase_seconds summary\n";
+    for (int p = 0; p < 3; ++p) {
+        const LatencySummary& h = s.phases[p];
+        const char* name = phaseNames[metricPhases[p]];
+        for (double q : metricQuantiles)
+            add("cinterp_phase_seconds{phase=\"%s\",quantile=\"%g\"} %.9g\n", name, q, h.quantile(q) / 1e9);
+        add("cinterp_phase_seconds_sum{phase=\"%s\"} %.9g\n", name, h.sum / 1e9);
+        add("cinterp_phase_seconds_count{phase=\"%s\"} %llu\n", name, (unsigned long long)h.count);
+    }
+    add("# HELP cinterp_programs_total Programs run to their end or to an error.\n"
+        "# TYPE cinterp_programs_total counter\ncinterp_programs_total %llu\n", (unsigned long long)s.programs);
+    text += "# HELP cinterp_errors_total Programs that stopped with an error, by kind.\n"
+            "# TYPE cinterp_errors_total counter\n";
+    for (int k = 0; k <= readError; ++k) {
+        if (k != (int)cinterp::ErrorKind::usage)
+            add("cinterp_errors_total{kind=\"%s\"} %llu\n", errorKindNames[k], (unsigned long long)s.errors[k]);
+    }
+    add("# HELP cinterp_lexed_bytes_total Source bytes lexed.\n"
+        "# TYPE cinterp_lexed_bytes_total counter\ncinterp_lexed_bytes_total %llu\n", (unsigned long long)s.bytesLexed);
+    add("# HELP cinterp_peak_memory_bytes Peak resident memory of the process.\n"
+        "# TYPE cinterp_peak_memory_bytes gauge\ncinterp_peak_memory_bytes %lld\n", s.peakBytes);
+    return text;
+}
+
+string metricsPath;
+long long metricsEveryMs = 1000;
+atomic<bool> metricsRequested{false};
+
+extern "C" void onMetricsSignal(int) {
+    metricsRequested.store(true);
+}
+
+// written beside the file and renamed over it, so a collector never reads
+// half of one
+void writeMetricsFile() {
+    string text = prometheusMetrics(readMetrics());
+    string temporary = metricsPath + ".tmp";
+    FILE* out = fopen(temporary.c_str(), "wb");
+    if (!out || fwrite(text.data(), 1, text.size(), out) != text.size() || fclose(out) != 0
+        || rename(temporary.c_str(), metricsPath.c_str()) != 0)
+        fprintf(stderr, "Error: cannot write '%s'\n", metricsPath.c_str());
+}
+
+// for the length of a batch: answers SIGUSR1 and keeps --metrics-file up to
+// date, from a thread of its own; the file is written once more at the end
+class MetricsReporter {
+public:
+    MetricsReporter() {
+        struct sigaction action = {};
+        action.sa_handler = onMetricsSignal;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGUSR1, &action, nullptr);
+        runner = thread([this] { report(); });
+    }
+
+    ~MetricsReporter() {
+        {
+            lock_guard<mutex> lock(stopLock);
+            stopping = true;
+        }
+        stopped.notify_one();
+        runner.join();
+        if (metricsRequested.exchange(false))
+            printMetrics(stderr, readMetrics());
+        if (!metricsPath.empty())
+            writeMetricsFile();
+    }
+
+private:
+    void report() {
+        long long nextWrite = nowNanos() + metricsEveryMs * 1000000;
+        unique_lock<mutex> lock(stopLock);
+        while (!stopped.wait_for(lock, chrono::milliseconds(20), [&] { return stopping; })) {
+            if (metricsRequested.exchange(false))
+                printMetrics(stderr, readMetrics());
+            if (!metricsPath.empty() && nowNanos() >= nextWrite) {
+                writeMetricsFile();
+                nextWrite = nowNanos() + metricsEveryMs * 1000000;
+            }
+        }
+    }
+
+    thread runner;
+    mutex stopLock;
+    condition_variable stopped;
+    bool stopping = false;
+};
+
+// --batch: runs the programs whose paths come on stdin, one per line, and
+// prints each one's output after a "=== PATH ===" line, in input order. The
+// work on consecutive programs overlaps in three stages: a scanner thread
+// reads and lexes a program (like --lexer=parallel, so a lexical error is
+// still reported where the parser reaches it), a front-end thread lays out
+// its header and declarations (cinterp::compile), and a pool of
+// --exec-threads executors runs its statements. The main thread writes the
+// results in order. Bounded single-producer single-consumer rings join the
+// stages: one from the scanner to the front-end, one from the front-end to
+// each executor and one from each executor to the writer. A stage whose ring
+// is full waits, so a slow stage holds back the ones before it. An error is
+// printed to stderr after the program's path, and makes the exit status 1.
+// --stats prints how each stage spent its time: working, waiting for input
+// (starved) and waiting for room downstream (blocked).
+
+// runs a program from its tokens, from start (after the declarations, when
+// declared holds them), and collects what a run of it alone prints: its
+// stdout in output and its error, if any, in error
+void runCaptured(const vector<Token>& tokens, size_t start, const vector<Symbol>* declared,
+                 const string& lexicalError, int lexicalLine, const cinterp::Limits& limits,
+                 string& output, string& error) {
+    if (textOutput())
+        output += "=== Running Parser + Interpreter ===\n";
+    outputCapture = &output;
+    long long phaseStart = nowNanos();
+    bool inBody = declared != nullptr;
+    try {
+        cinterp::EmbeddedState state(&tokens, start);
+        // a fresh table, filled in declaration order, lists in the same
+        // order as a run of the program alone
+        symbolTable = unordered_map<string, Symbol>();
+        if (declared) {
+            for (const Symbol& sym : *declared) {
+                declarationOrder.push_back(sym.name);
+                symbolTable.emplace(sym.name, sym);
+            }
+        }
+        tokenStreamError = lexicalError;
+        tokenStreamErrorLine = lexicalLine;
+        setLimits(limits.maxSteps, limits.timeoutMs);
+        currentToken = getToken();
+        if (!declared) {
+            match(PROGRAM);
+            match(ID);
+            match(LBRACE);
+            declaration_list();
+            endPhase(phaseParse, phaseStart);
+            phaseStart = nowNanos();
+            inBody = true;
+        }
+        program_body();
+        if (textOutput())
+            output += "Parsing completed successfully!\n";
+        printFinalTable();
+    } catch (const cinterp::Error& e) {
+        error = e.what();
+        if (metrics)
+            MetricsShard::count(metrics->errors[(int)e.kind]);
+    }
+    endPhase(inBody ? phaseExecute : phaseParse, phaseStart);
+    outputCapture = nullptr;
+    tokenStreamError.clear();
+}
+
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity)
+            size <<= 1;
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    bool tryPush(T& item) {
+        size_t at = tail.load(memory_order_relaxed);
+        if (at - headSeen == slots.size()) {
+            headSeen = head.load(memory_order_acquire);
+            if (at - headSeen == slots.size())
+                return false;
+        }
+        slots[at & mask] = move(item);
+        tail.store(at + 1, memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& item) {
+        size_t at = head.load(memory_order_relaxed);
+        if (at == tailSeen) {
+            tailSeen = tail.load(memory_order_acquire);
+            if (at == tailSeen)
+                return false;
+        }
+        item = move(slots[at & mask]);
+        head.store(at + 1, memory_order_release);
+        return true;
+    }
+
+private:
+    vector<T> slots;
+    size_t mask;
+    alignas(64) atomic<size_t> head{0};     // the consumer's side
+    size_t tailSeen = 0;
+    alignas(64) atomic<size_t> tail{0};     // the producer's side
+    size_t headSeen = 0;
+};
+
+struct StageClock {
+    long long busy = 0;     // ns
+    long long starved = 0;
+    long long blocked = 0;
+    size_t items = 0;
+};
+
+// spins briefly, then yields, then sleeps: a stage may share its core with
+// the one it waits for
+template <typename Ready>
+void waitUntil(long long& waited, Ready ready) {
+    if (ready())
+        return;
+    long long start = nowNanos();
+    for (int tries = 0; !ready(); ++tries) {
+        if (tries >= 256)
+            this_thread::sleep_for(chrono::microseconds(50));
+        else if (tries >= 16)
+            this_thread::yield();
+    }
+    waited += nowNanos() - start;
+}
+
+struct BatchItem {
+    size_t index;
+    string path;
+    bool read = false;
+    vector<Token> tokens;
+    string lexicalError;    // at the end of tokens
+    int lexicalLine = 0;
+    shared_ptr<const cinterp::CompiledProgram> compiled;
+    string output;
+    string error;           // what a run of it alone prints to stderr
+};
+
+using BatchSlot = unique_ptr<BatchItem>;    // null ends the stream
+
+int batchSession(int execThreads, size_t queueSize, const cinterp::Limits& limits) {
+    long long start = nowNanos();
+    execThreads = max(execThreads, 1);
+    SpscRing<BatchSlot> toFront(queueSize);
+    vector<unique_ptr<SpscRing<BatchSlot>>> toExec, toWrite;
+    for (int i = 0; i < execThreads; ++i) {
+        toExec.push_back(make_unique<SpscRing<BatchSlot>>(queueSize));
+        toWrite.push_back(make_unique<SpscRing<BatchSlot>>(queueSize));
+    }
+    StageClock scanClock, frontClock, writeClock;
+    vector<StageClock> execClocks(execThreads);
+
+    MetricsReporter reporter;
+    metrics = newMetricsShard();
+    thread scanner([&] {
+        metrics = newMetricsShard();
+        nameTraceThread("scan");
+        size_t index = 0;
+        string path;
+        for (;;) {
+            long long waitStart = nowNanos();
+            bool more = (bool)getline(cin, path);
+            scanClock.starved += nowNanos() - waitStart;
+            if (!more)
+                break;
+            if (path.empty())
+                continue;
+            long long workStart = nowNanos();
+            BatchSlot item = make_unique<BatchItem>();
+            item->index = index++;
+            item->path = path;
+            if (FILE* in = fopen(path.c_str(), "rb")) {
+                item->read = true;
+                string source = readAll(in);
+                fclose(in);
+                long long lexStart = nowNanos();
+                item->tokens = lexParallel(source);
+                endPhase(phaseLex, lexStart);
+                MetricsShard::count(metrics->bytesLexed, source.size());
+                item->lexicalError = move(tokenStreamError);
+                item->lexicalLine = tokenStreamErrorLine;
+            } else {
+                item->error = "Error: cannot read '" + path + "'";
+                MetricsShard::count(metrics->errors[readError]);
+            }
+            scanClock.busy += nowNanos() - workStart;
+            scanClock.items++;
+            waitUntil(scanClock.blocked, [&] { return toFront.tryPush(item); });
+        }
+        BatchSlot end;
+        waitUntil(scanClock.blocked, [&] { return toFront.tryPush(end); });
+    });
+
+    thread frontEnd([&] {
+        metrics = newMetricsShard();
+        nameTraceThread("front end");
+        size_t next = 0;
+        for (;;) {
+            BatchSlot item;
+            waitUntil(frontClock.starved, [&] { return toFront.tryPop(item); });
+            if (!item)
+                break;
+            long long workStart = nowNanos();
+            if (item->read) {
+                tokenStreamError = item->lexicalError;
+                tokenStreamErrorLine = item->lexicalLine;
+                try {
+                    item->compiled = cinterp::compileTokens(move(item->tokens));
+                } catch (const cinterp::Error& e) {
+                    item->error = e.what();
+                    MetricsShard::count(metrics->errors[(int)e.kind]);
+                }
+                endPhase(phaseParse, workStart);
+                tokenStreamError.clear();
+            }
+            frontClock.busy += nowNanos() - workStart;
+            frontClock.items++;
+            // the next executor with room, round robin
+            waitUntil(frontClock.blocked, [&] {
+                for (int k = 0; k < execThreads; ++k) {
+                    size_t i = (next + k) % execThreads;
+                    if (toExec[i]->tryPush(item)) {
+                        next = i + 1;
+                        return true;
+                    }
+                }
+                return false;
+            });
+        }
+        for (auto& ring : toExec) {
+            BatchSlot end;
+            waitUntil(frontClock.blocked, [&] { return ring->tryPush(end); });
+        }
+    });
+
+    vector<thread> executors;
+    for (int i = 0; i < execThreads; ++i) {
+        executors.emplace_back([&, i] {
+            StageClock& clock = execClocks[i];
+            metrics = newMetricsShard();
+            nameTraceThread("execute " + to_string(i + 1));
+            throwErrors = true;
+            for (;;) {
+                BatchSlot item;
+                waitUntil(clock.starved, [&] { return toExec[i]->tryPop(item); });
+                if (!item)
+                    break;
+                long long workStart = nowNanos();
+                if (item->compiled) {
+                    const cinterp::CompiledProgram& compiled = *item->compiled;
+                    runCaptured(compiled.tokens, compiled.bodyStart, &compiled.declared, item->lexicalError,
+                                item->lexicalLine, limits, item->output, item->error);
+                    item->compiled.reset();
+                } else if (item->read && textOutput()) {
+                    item->output = "=== Running Parser + Interpreter ===\n";
+                }
+                clock.busy += nowNanos() - workStart;
+                clock.items++;
+                waitUntil(clock.blocked, [&] { return toWrite[i]->tryPush(item); });
+            }
+            BatchSlot end;
+            waitUntil(clock.blocked, [&] { return toWrite[i]->tryPush(end); });
+        });
+    }
+
+    // results come from the executors out of order; they are written in order
+    map<size_t, BatchSlot> waiting;
+    size_t next = 0;
+    int open = execThreads;
+    vector<bool> closed(execThreads);
+    bool failed = false;
+    while (open > 0) {
+        waitUntil(writeClock.starved, [&] {
+            bool got = false;
+            for (int i = 0; i < execThreads; ++i) {
+                BatchSlot item;
+                if (closed[i] || !toWrite[i]->tryPop(item))
+                    continue;
+                got = true;
+                if (!item) {
+                    closed[i] = true;
+                    open--;
+                } else {
+                    waiting.emplace(item->index, move(item));
+                }
+            }
+            return got;
+        });
+        long long workStart = nowNanos();
+        for (auto it = waiting.begin(); it != waiting.end() && it->first == next; it = waiting.erase(it), ++next) {
+            BatchItem& item = *it->second;
+            printf("=== %s ===\n", item.path.c_str());
+            fwrite(item.output.data(), 1, item.output.size(), stdout);
+            if (!item.error.empty()) {
+                fflush(stdout);
+                fprintf(stderr, "%s: %s\n", item.path.c_str(), item.error.c_str());
+                failed = true;
+            }
+            MetricsShard::count(metrics->programs);
+            writeClock.items++;
+        }
+        writeClock.busy += nowNanos() - workStart;
+    }
+    fflush(stdout);
+    scanner.join();
+    frontEnd.join();
+    for (thread& t : executors)
+        t.join();
+
+    if (statsMode) {
+        double wall = (nowNanos() - start) / 1e9;
+        StageClock exec;
+        for (const StageClock& c : execClocks) {
+            exec.busy += c.busy;
+            exec.starved += c.starved;
+            exec.blocked += c.blocked;
+            exec.items += c.items;
+        }
+        auto row = [&](const char* name, int threads, const StageClock& c) {
+            double total = wall * threads * 1e9;
+            fprintf(stderr, "%-10s %7d %7zu %7.1f%% %7.1f%% %7.1f%%\n", name, threads, c.items,
+                    100 * c.busy / total, 100 * c.starved / total, 100 * c.blocked / total);
+        };
+        fprintf(stderr, "=== Pipeline ===\n%-10s %7s %7s %8s %8s %8s\n", "stage", "threads", "items", "busy",
+                "starved", "blocked");
+        row("scan", 1, scanClock);
+        row("front-end", 1, frontClock);
+        row("execute", execThreads, exec);
+        row("write", 1, writeClock);
+        fprintf(stderr, "%.1f ms, rings of %zu\n", wall * 1e3, queueSize);
+        printMetrics(stderr, readMetrics());
+    }
+    return failed ? 1 : 0;
+}
+
+// --batch=steal: the same output as --batch, built for many small programs.
+// The pipeline hands each program from stage to stage, which costs more than
+// a program of a few microseconds takes to run. Here each of --exec-threads
+// workers reads, lexes and runs whole programs, keeping its source, token and
+// output buffers from one to the next. The paths are read up front and cut
+// into chunks of --batch-chunk programs, dealt out in turn to the workers'
+// deques. A worker takes its own chunks in order; when it has none left it
+// steals the last chunk of another worker. Each program's result goes into a
+// slot of its own, marked done with a release store. The main thread writes
+// the slots in order as they are done, so no lock is shared. --stats prints
+// what each worker did.
+
+// Chase-Lev deque of chunk numbers (Lê et al., "Correct and efficient
+// work-stealing for weak memory models"): the owner pops at the bottom,
+// thieves take from the top. Everything is pushed before the workers start,
+// so the buffer never grows and is only read while they run.
+class StealDeque {
+public:
+    enum Steal { taken, empty, lost };
+
+    void push(size_t item) {
+        items.push_back(item);
+        bottom.store(items.size(), memory_order_relaxed);
+    }
+
+    bool pop(size_t& item) {
+        long long b = bottom.load(memory_order_relaxed) - 1;
+        bottom.store(b, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        long long t = top.load(memory_order_relaxed);
+        if (t > b) {
+            bottom.store(b + 1, memory_order_relaxed);
+            return false;
+        }
+        item = items[b];
+        if (t < b)
+            return true;
+        // the last one: a thief may be taking it too
+        bool won = top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed);
+        bottom.store(b + 1, memory_order_relaxed);
+        return won;
+    }
+
+    Steal steal(size_t& item) {
+        long long t = top.load(memory_order_acquire);
+        atomic_thread_fence(memory_order_seq_cst);
+        long long b = bottom.load(memory_order_acquire);
+        if (t >= b)
+            return empty;
+        item = items[t];
+        return top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed) ? taken : lost;
+    }
+
+private:
+    vector<size_t> items;
+    alignas(64) atomic<long long> top{0};
+    alignas(64) atomic<long long> bottom{0};
+};
+
+struct alignas(64) StealWorker {
+    StealDeque chunks;
+    string source;          // reused from one program to the next
+    vector<Token> tokens;
+    string output;
+    StageClock clock;       // starved: looking for a chunk to steal
+    size_t chunksRun = 0;
+    size_t stolen = 0;
+};
+
+struct BatchResult {
+    string text;            // "=== PATH ===" and the program's output
+    string error;
+    atomic<bool> done{false};
+};
+
+int stealSession(int workers, size_t chunkSize, const cinterp::Limits& limits) {
+    long long start = nowNanos();
+    workers = max(workers, 1);
+    chunkSize = max<size_t>(chunkSize, 1);
+
+    vector<string> paths;
+    string list = readAll(stdin);
+    for (size_t at = 0; at < list.size();) {
+        size_t end = list.find('\n', at);
+        if (end == string::npos)
+            end = list.size();
+        if (end > at)
+            paths.emplace_back(list, at, end - at);
+        at = end + 1;
+    }
+    string().swap(list);
+
+    unique_ptr<BatchResult[]> results(new BatchResult[paths.size()]);
+    vector<unique_ptr<StealWorker>> pool;
+    for (int i = 0; i < workers; ++i)
+        pool.push_back(make_unique<StealWorker>());
+    // chunk c goes to worker c % workers, pushed last to first so that the
+    // owner pops them in order and thieves take the ones needed last
+    size_t chunkCount = (paths.size() + chunkSize - 1) / chunkSize;
+    for (size_t c = chunkCount; c-- > 0;)
+        pool[c % workers]->chunks.push(c);
+
+    MetricsReporter reporter;
+    metrics = newMetricsShard();
+    vector<thread> threads;
+    for (int i = 0; i < workers; ++i) {
+        threads.emplace_back([&, i] {
+            StealWorker& self = *pool[i];
+            metrics = newMetricsShard();
+            nameTraceThread("worker " + to_string(i + 1));
+            minstd_rand random(i + 1);
+            throwErrors = true;
+            for (;;) {
+                size_t chunk;
+                if (!self.chunks.pop(chunk)) {
+                    long long waitStart = nowNanos();
+                    bool found = false;
+                    // a lost race means a deque was not empty: look again
+                    for (bool lost = true; lost && !found;) {
+                        lost = false;
+                        size_t first = random() % workers;
+                        for (int k = 0; k < workers && !found; ++k) {
+                            size_t victim = (first + k) % workers;
+                            if (victim == (size_t)i)
+                                continue;
+                            StealDeque::Steal got = pool[victim]->chunks.steal(chunk);
+                            found = got == StealDeque::taken;
+                            lost |= got == StealDeque::lost;
+                        }
+                    }
+                    self.clock.starved += nowNanos() - waitStart;
+                    if (!found)
+                        break;
+                    self.stolen++;
+                }
+                long long workStart = nowNanos();
+                size_t end = min(paths.size(), (chunk + 1) * chunkSize);
+                for (size_t j = chunk * chunkSize; j < end; ++j) {
+                    BatchResult& result = results[j];
+                    result.text.append("=== ").append(paths[j]).append(" ===\n");
+                    if (FILE* in = fopen(paths[j].c_str(), "rb")) {
+                        readAll(in, self.source);
+                        fclose(in);
+                        long long lexStart = nowNanos();
+                        lexInto(self.source, self.tokens);
+                        endPhase(phaseLex, lexStart);
+                        MetricsShard::count(metrics->bytesLexed, self.source.size());
+                        string lexicalError = move(tokenStreamError);
+                        self.output.clear();
+                        runCaptured(self.tokens, 0, nullptr, lexicalError, tokenStreamErrorLine, limits, self.output,
+                                    result.error);
+                        result.text += self.output;
+                    } else {
+                        result.error = "Error: cannot read '" + paths[j] + "'";
+                        MetricsShard::count(metrics->errors[readError]);
+                    }
+                    result.done.store(true, memory_order_release);
+                }
+                self.clock.busy += nowNanos() - workStart;
+                self.clock.items += end - chunk * chunkSize;
+                self.chunksRun++;
+            }
+        });
+    }
+
+    StageClock writeClock;
+    bool failed = false;
+    for (size_t j = 0; j < paths.size(); ++j) {
+        BatchResult& result = results[j];
+        waitUntil(writeClock.starved, [&] { return result.done.load(memory_order_acquire); });
+        fwrite(result.text.data(), 1, result.text.size(), stdout);
+        if (!result.error.empty()) {
+            fflush(stdout);
+            fprintf(stderr, "%s: %s\n", paths[j].c_str(), result.error.c_str());
+            failed = true;
+        }
+        MetricsShard::count(metrics->programs);
+        string().swap(result.text);
+        string().swap(result.error);
+    }
+    fflush(stdout);
+    for (thread& t : threads)
+        t.join();
+
+    if (statsMode) {
+        double wall = (nowNanos() - start) / 1e9;
+        fprintf(stderr, "=== Work stealing ===\n%-8s %9s %7s %7s %8s %8s\n", "worker", "programs", "chunks", "stolen",
+                "busy", "idle");
+        for (int i = 0; i < workers; ++i) {
+            const StealWorker& w = *pool[i];
+            fprintf(stderr, "%-8d %9zu %7zu %7zu %7.1f%% %7.1f%%\n", i, w.clock.items, w.chunksRun, w.stolen,
+                    100 * w.clock.busy / (wall * 1e9), 100 * w.clock.starved / (wall * 1e9));
+        }
+        fprintf(stderr, "%.1f ms, %zu programs in chunks of %zu, writer waited %.1f%%\n", wall * 1e3, paths.size(),
+                chunkSize, 100 * writeClock.starved / (wall * 1e9));
+        printMetrics(stderr, readMetrics());
+    }
+    return failed ? 1 : 0;
+}
+
+// --stats, --parallelism, --profile and --perf report from an exit handler,
+// like --trace, so a run stopped by an error or a limit still reports what
+// it did up to there; the scopes an error left open are closed first
+void printReports() {
+    if (statsMode) {
+        cerr << "=== Stats ===\n"
+             << "bounds checks with a constant index: " << boundsChecksConstant << "\n"
+             << "bounds checks with a variable index: " << boundsChecksVariable << "\n";
+    }
+    if (parallelismMode) {
+        printParallelismReport();
+    }
+    if (profileMode) {
+        while (!profileStack.empty())
+            profileLeave();
+        printProfile();
+    }
+    if (perfMode) {
+        samplePhase();
+        phaseStack.clear();
+        printPhaseCounters();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    
+    traceOrigin = nowNanos();
+    string resumePath;
+    string lexer = "flex";
+    bool dumpTokens = false;
+    bool countTokens = false;
+    string incrementalPath;
+    bool repl = false;
+    string batch;
+    int execThreads = max(1, (int)thread::hardware_concurrency() - 2);
+    size_t batchQueue = 16;
+    size_t batchChunk = 64;
+    cinterp::Limits limits;
+    auto usage = [&] {
+        cerr << "Usage: " << argv[0] << " [--stats] [--parallelism] [--profile[=stacks.folded]] [--perf] [--trace=out.json] [--cache=DIR]\n"
+             << "       [--checkpoint=FILE [--checkpoint-every=N]] [--resume=FILE]\n"
+             << "       [--format=text|sorted|json|binary] [--lexer=flex|hand|parallel] [--lex-threads=N] [--lex-chunk=BYTES]\n"
+             << "       [--max-steps=N] [--timeout-ms=N]\n"
+             << "       [--dump-tokens | --count-tokens] < program.txt\n"
+             << "       " << argv[0] << " [--format=...] --incremental=program.txt < commands\n"
+             << "       " << argv[0] << " [--format=...] [--max-steps=N] [--timeout-ms=N] --repl\n"
+             << "       " << argv[0] << " [--stats] [--format=...] [--max-steps=N] [--timeout-ms=N] [--lex-threads=N]\n"
+             << "       [--exec-threads=N] [--batch-queue=N | --batch-chunk=N] [--metrics-file=PATH [--metrics-every=MS]]\n"
+             << "       [--trace=out.json] --batch[=pipeline|steal] < paths" << endl;
+        return 1;
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--stats") {
+            statsMode = true;
+        } else if (arg == "--parallelism") {
+            parallelismMode = true;
+        } else if (arg == "--profile" || arg.rfind("--profile=", 0) == 0) {
+            profileMode = true;
+            profileNodes.reserve(1 << 16);
+            profileStartTicks = profileTicks();
+            profileStartNanos = nowNanos();
+            if (arg.size() > 10)
+                profileStacksPath = arg.substr(10);
+        } else if (arg == "--perf") {
+            perfMode = true;
+        } else if (arg.rfind("--cache=", 0) == 0 && arg.size() > 8) {
+            cacheDir = arg.substr(8);
+        } else if (arg.rfind("--checkpoint=", 0) == 0 && arg.size() > 13) {
+            checkpointPath = arg.substr(13);
+        } else if (arg.rfind("--checkpoint-every=", 0) == 0 && atoll(arg.c_str() + 19) > 0) {
+            checkpointEvery = atoll(arg.c_str() + 19);
+        } else if (arg.rfind("--resume=", 0) == 0 && arg.size() > 9) {
+            resumePath = arg.substr(9);
+        } else if (arg == "--format=text") {
+            outputFormat = formatText;
+        } else if (arg == "--format=sorted") {
+            outputFormat = formatSorted;
+        } else if (arg == "--format=json") {
+            outputFormat = formatJson;
+        } else if (arg == "--format=binary") {
+            outputFormat = formatBinary;
+        } else if (arg == "--lexer=flex" || arg == "--lexer=hand" || arg == "--lexer=parallel") {
+            lexer = arg.substr(8);
+        } else if (arg.rfind("--lex-threads=", 0) == 0 && arg.size() > 14) {
+            lexThreads = atoi(arg.c_str() + 14);
+        } else if (arg.rfind("--lex-chunk=", 0) == 0 && arg.size() > 12) {
+            lexChunkBytes = strtoull(arg.c_str() + 12, nullptr, 10);
+        } else if (arg.rfind("--incremental=", 0) == 0 && arg.size() > 14) {
+            incrementalPath = arg.substr(14);
+        } else if (arg == "--repl") {
+            repl = true;
+        } else if (arg == "--batch" || arg == "--batch=pipeline" || arg == "--batch=steal") {
+            batch = arg == "--batch=steal" ? "steal" : "pipeline";
+        } else if (arg.rfind("--exec-threads=", 0) == 0 && atoi(arg.c_str() + 15) > 0) {
+            execThreads = atoi(arg.c_str() + 15);
+        } else if (arg.rfind("--batch-queue=", 0) == 0 && atoi(arg.c_str() + 14) > 0) {
+            batchQueue = atoi(arg.c_str() + 14);
+        } else if (arg.rfind("--batch-chunk=", 0) == 0 && atoi(arg.c_str() + 14) > 0) {
+            batchChunk = atoi(arg.c_str() + 14);
+        } else if (arg.rfind("--metrics-file=", 0) == 0 && arg.size() > 15) {
+            metricsPath = arg.substr(15);
+        } else if (arg.rfind("--metrics-every=", 0) == 0 && atoll(arg.c_str() + 16) > 0) {
+            metricsEveryMs = atoll(arg.c_str() + 16);
+        } else if (arg.rfind("--max-steps=", 0) == 0 && arg.size() > 12) {
+            limits.maxSteps = strtoull(arg.c_str() + 12, nullptr, 10);
+        } else if (arg.rfind("--timeout-ms=", 0) == 0 && arg.size() > 13) {
+            limits.timeoutMs = (uint32_t)min<unsigned long long>(strtoull(arg.c_str() + 13, nullptr, 10), UINT32_MAX);
+        } else if (arg == "--dump-tokens") {
+            dumpTokens = true;
+        } else if (arg == "--count-tokens") {
+            countTokens = true;
+        } else if (arg.rfind("--trace=", 0) == 0 && arg.size() > 8) {
+            tracePath = arg.substr(8);
+        } else {
+            return usage();
+        }
+    }
+    // both kinds of batch run programs on many threads at once, and the rest
+    // of the instrumentation (profiles, counters, checkpoints, the cache)
+    // keeps one run's state per process. Only what is listed here is made
+    // safe for that, so a new option is turned away until it is added.
+    if (!batch.empty()) {
+        static const char* const batchOptions[] = {
+            "--batch", "--stats", "--format=", "--exec-threads=", "--metrics-file=", "--metrics-every=",
+            "--max-steps=", "--timeout-ms=", "--lex-threads=", "--lex-chunk=", "--trace=",
+        };
+        for (int i = 1; i < argc; ++i) {
+            string arg = argv[i];
+            if (none_of(begin(batchOptions), end(batchOptions), [&](const char* o) { return arg.rfind(o, 0) == 0; })) {
+                cerr << "Error: " << arg << " cannot be used with --batch" << endl;
+                return usage();
+            }
+        }
+    }
+
+    executeIf = true;
+    if (perfMode)
+        openHardwareCounters();
+    if (!tracePath.empty()) {
+        atexit(writeTrace);     // once, however many --trace options were given
+        traceSpan("startup", "startup", traceOrigin);
+    }
+    if (!incrementalPath.empty())
+        return editSession(incrementalPath);
+    if (repl)
+        return replSession(limits);
+    if (batch == "steal")
+        return stealSession(execThreads, batchChunk, limits);
+    if (!batch.empty())
+        return batchSession(execThreads, batchQueue, limits);
+
+    // instrumented, checkpointed and limited runs have to execute, so they
+    // neither read nor fill the cache
+    bool useCache = !cacheDir.empty() && !statsMode && !parallelismMode
+                    && !profileMode && !perfMode && tracePath.empty()
+                    && checkpointPath.empty() && resumePath.empty()
+                    && !limits.maxSteps && !limits.timeoutMs;
+    string source;
+    if (useCache || !checkpointPath.empty() || !resumePath.empty() || lexer != "flex" || countTokens) {
+        source = readAll(stdin);
+        sourceKey = cacheKey(source);
+        if (useCache && printCachedResult(sourceKey)) {
+            return 0;
+        }
+        if (lexer == "flex")
+            yy_scan_bytes(source.data(), (int)source.size());
+    }
+    unique_ptr<handscanner::HandScanner> scanner;
+    if (lexer == "hand") {
+        scanner = make_unique<handscanner::HandScanner>(source.data(), source.size());
+        handScanner = scanner.get();
+    }
+    vector<Token> tokens;
+    long long lexNanos = 0;
+    if (lexer == "parallel") {
+        TraceScope trace("lex", "lex");
+        PhaseScope phase(phaseLex);
+        long long start = nowNanos();
+        tokens = lexParallel(source);
+        lexNanos = nowNanos() - start;
+        tokenStream = &tokens;
+        tokenPosition = 0;
+        string().swap(source);     // the tokens hold their own text
+    }
+
+    // --dump-tokens: the token stream, one per line, to compare scanners;
+    // --count-tokens: scanner throughput from memory, without the parser
+    if (dumpTokens) {
+        for (;;) {
+            Token token = getToken();
+            if (token.type == PROGRAM && token.value.empty())
+                return 0;
+            cout << token.line << "\t" << tokenTypeNames[token.type] << "\t" << token.value << "\n";
+        }
+    }
+    if (countTokens) {
+        long long count = 0;
+        long long start = nowNanos();
+        if (tokenStream) {
+            count = tokens.size() - 1;  // the end of input or an error
+            start -= lexNanos;
+        } else if (handScanner) {
+            while (handScanner->next() != 0 || handScanner->length > 0)
+                count++;
+        } else {
+            while (yylex() != 0 || yytext[0] != '\0')
+                count++;
+        }
+        double seconds = (nowNanos() - start) / 1e9;
+        printf("%lld tokens in %.3f ms, %.0f tokens/s\n", count, seconds * 1e3, count / seconds);
+        return 0;
+    }
+
+    if (!resumePath.empty()) {
+        if (!restoreCheckpoint(resumePath)) {
+            cerr << "Error: '" << resumePath << "' is not a checkpoint of this program" << endl;
+            return 1;
+        }
+    } else {
+        currentToken = getToken(); // Initialize the first token
+    }
+
+    if (currentToken.type == UNKNOWN) {
+        cerr << "Error: lexer couldn't initialize properly!" << endl;
+        return 1;
+    }
+
+    if (statsMode || parallelismMode || profileMode || perfMode)
+        atexit(printReports);
+    if (textOutput())
+        cout << "=== Running Parser + Interpreter ===\n";
+    {
+        ProfileScope profile(kindProgram, currentToken.line);
+        TraceScope trace("parse", "parse");
+        PhaseScope phase(phaseParse);
+        setLimits(limits.maxSteps, limits.timeoutMs);
+        if (resumePath.empty())
+            program(); // Start parsing
+        else
+            program_body();
+    }
+    if (textOutput())
+        cout << "Parsing completed successfully!" << endl;
+
+    {
+        TraceScope trace("symbol table", "output");
+        PhaseScope phase(phaseOutput);
+        printFinalTable();
+        fflush(stdout);
+    }
+    if (useCache) {
+        storeCachedResult(sourceKey);
     }
 
     return 0;
 }
+#endif // CINTERP_NO_MAIN
@@ -23,6 +23,14 @@ enum TokenType {
 extern char* yytext;    // yytext contains the matched text of the current token
 extern int yylineno;    // yylineno contains the current line number
 
+/*
+   lexical_error: the scanner reports every lexical error through this hook,
+   with a printf-style message. The command-line interpreter prints it and
+   exits; embedded, it is recorded and the scanner returns UNKNOWN (or ends
+   the input) so the caller can raise it.
+*/
+void lexical_error(const char *format, ...);
+
 /* 
    addToken: the scanner calls this function each time it recognizes a token.
    Parameters: